@@ -0,0 +1,414 @@
+/* gsound-bench.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks for the play and cache paths of GSoundContext.
+ *
+ * By default these run against libcanberra's "null" driver, which accepts
+ * every sound and finishes it straight away, so the numbers measure GSound
+ * and libcanberra rather than the sound server. Results are printed as a
+ * single JSON object on stdout, for example
+ *
+ *   { "driver": "null", "iterations": 10000, "benchmarks": [
+ *     { "name": "play-simple", "ops": 10000, "errors": 0,
+ *       "total_us": 5316, "ns_per_op": 531.6, ... }, ... ] }
+ *
+ * play-cancel always uses GSound's own "gsound-null" driver instead, so
+ * that sounds are still playing when they are cancelled.
+ *
+ * Benchmarks which time each operation separately also report the mean,
+ * median and 99th percentile in microseconds.
+ */
+
+#include "gsound.h"
+
+#include <stdlib.h>
+
+#define EVENT_ID "bell-window-system"
+
+static int iterations = 10000;
+static char *driver = NULL;
+static gboolean first_result = TRUE;
+
+static GOptionEntry entries[] = {
+  { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+    "Number of operations in each benchmark (default: 10000)", "N" },
+  { "driver", 'd', 0, G_OPTION_ARG_STRING, &driver,
+    "libcanberra driver to use (default: null)", "DRIVER" },
+  { NULL }
+};
+
+typedef struct
+{
+  const char *name;
+  guint       ops;
+  guint       errors;
+  gint64      total_us;
+
+  /* Per-operation samples in microseconds, if any */
+  GArray     *samples;
+} BenchResult;
+
+static void
+bench_result_init (BenchResult *result,
+                   const char  *name,
+                   gboolean     with_samples)
+{
+  result->name = name;
+  result->ops = 0;
+  result->errors = 0;
+  result->total_us = 0;
+  result->samples = with_samples ? g_array_new (FALSE, FALSE, sizeof (gint64))
+                                 : NULL;
+}
+
+static gint
+compare_samples (gconstpointer a,
+                 gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return (x > y) - (x < y);
+}
+
+static gint64
+percentile (GArray *samples,
+            guint   pct)
+{
+  guint index;
+
+  if (samples->len == 0)
+    return 0;
+
+  index = MIN ((samples->len * pct) / 100, samples->len - 1);
+
+  return g_array_index (samples, gint64, index);
+}
+
+static void
+bench_result_print (BenchResult *result)
+{
+  g_print ("%s\n    { \"name\": \"%s\", \"ops\": %u, \"errors\": %u, "
+           "\"total_us\": %" G_GINT64_FORMAT ", \"ns_per_op\": %.1f",
+           first_result ? "" : ",",
+           result->name, result->ops, result->errors, result->total_us,
+           result->ops ? (result->total_us * 1000.0) / result->ops : 0.0);
+
+  if (result->samples)
+    {
+      gint64 sum = 0;
+      guint i;
+
+      g_array_sort (result->samples, compare_samples);
+      for (i = 0; i < result->samples->len; i++)
+        sum += g_array_index (result->samples, gint64, i);
+
+      g_print (", \"mean_us\": %.2f, \"p50_us\": %" G_GINT64_FORMAT
+               ", \"p99_us\": %" G_GINT64_FORMAT,
+               result->samples->len ? (double) sum / result->samples->len : 0.0,
+               percentile (result->samples, 50),
+               percentile (result->samples, 99));
+
+      g_array_unref (result->samples);
+    }
+
+  g_print (" }");
+  first_result = FALSE;
+}
+
+static GHashTable *
+make_attrs_table (void)
+{
+  GHashTable *attrs;
+
+  attrs = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_insert (attrs, GSOUND_ATTR_EVENT_ID, EVENT_ID);
+  g_hash_table_insert (attrs, GSOUND_ATTR_EVENT_DESCRIPTION, "Benchmark");
+  g_hash_table_insert (attrs, GSOUND_ATTR_CANBERRA_CACHE_CONTROL, "never");
+
+  return attrs;
+}
+
+/* How long it takes to turn a hash table into a GSoundAttributes */
+static void
+bench_attributes_new (void)
+{
+  GHashTable *table = make_attrs_table ();
+  BenchResult result;
+  gint64 start;
+  int i;
+
+  bench_result_init (&result, "attributes-newv", FALSE);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      GSoundAttributes *attrs = gsound_attributes_newv (table, NULL);
+
+      if (attrs)
+        gsound_attributes_unref (attrs);
+      else
+        result.errors++;
+    }
+  result.total_us = g_get_monotonic_time () - start;
+  result.ops = iterations;
+
+  g_hash_table_unref (table);
+  bench_result_print (&result);
+}
+
+/* Fire-and-forget submission rate, with and without prebuilt attributes */
+static void
+bench_play_simple (GSoundContext *ctx)
+{
+  GHashTable *table = make_attrs_table ();
+  GSoundAttributes *attrs;
+  BenchResult result;
+  gint64 start;
+  int i;
+
+  bench_result_init (&result, "play-simplev", FALSE);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    if (!gsound_context_play_simplev (ctx, table, NULL, NULL))
+      result.errors++;
+  result.total_us = g_get_monotonic_time () - start;
+  result.ops = iterations;
+
+  bench_result_print (&result);
+
+  attrs = gsound_attributes_newv (table, NULL);
+  bench_result_init (&result, "play-attrs", FALSE);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    if (!gsound_context_play_attrs (ctx, attrs, NULL, NULL))
+      result.errors++;
+  result.total_us = g_get_monotonic_time () - start;
+  result.ops = iterations;
+
+  bench_result_print (&result);
+
+  gsound_attributes_unref (attrs);
+  g_hash_table_unref (table);
+}
+
+/*
+ * The cost of playing a sound with a cancellable and then cancelling it.
+ * libcanberra's "null" driver finishes sounds before they could be
+ * cancelled, so this always uses GSound's own null driver, with sounds
+ * which play for longer than the benchmark takes.
+ */
+static void
+bench_cancel (void)
+{
+  GSoundAttributes *attrs;
+  GSoundContext *ctx;
+  GHashTable *table;
+  BenchResult result;
+  GError *error = NULL;
+  int i;
+
+  ctx = gsound_context_new (NULL, &error);
+  if (ctx && !gsound_context_set_driver (ctx, GSOUND_DRIVER_NULL, &error))
+    g_clear_object (&ctx);
+
+  if (!ctx)
+    {
+      g_printerr ("Failed to set up the sound context: %s\n", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  gsound_context_set_simulated_duration (ctx, 60 * 1000);
+
+  table = make_attrs_table ();
+  attrs = gsound_attributes_newv (table, NULL);
+  g_hash_table_unref (table);
+
+  bench_result_init (&result, "play-cancel", TRUE);
+
+  for (i = 0; i < iterations; i++)
+    {
+      GCancellable *cancellable = g_cancellable_new ();
+      gint64 start;
+
+      if (!gsound_context_play_attrs (ctx, attrs, cancellable, NULL))
+        result.errors++;
+
+      start = g_get_monotonic_time ();
+      g_cancellable_cancel (cancellable);
+      start = g_get_monotonic_time () - start;
+
+      g_array_append_val (result.samples, start);
+      result.total_us += start;
+      result.ops++;
+
+      g_object_unref (cancellable);
+    }
+
+  /* Let the deferred signal disconnections run */
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  gsound_attributes_unref (attrs);
+  g_object_unref (ctx);
+  bench_result_print (&result);
+}
+
+typedef struct
+{
+  BenchResult *result;
+  GMainLoop   *loop;
+  gint64       start;
+  guint        pending;
+} FullData;
+
+static void
+on_play_full_finished (GObject      *object,
+                       GAsyncResult *res,
+                       gpointer      user_data)
+{
+  FullData *data = user_data;
+  gint64 usec = g_get_monotonic_time () - data->start;
+
+  if (!gsound_context_play_full_finish (GSOUND_CONTEXT (object), res, NULL))
+    data->result->errors++;
+
+  g_array_append_val (data->result->samples, usec);
+  data->result->ops++;
+
+  if (--data->pending == 0)
+    g_main_loop_quit (data->loop);
+}
+
+/*
+ * The time from calling play_fullv() until the callback runs, one sound
+ * at a time, so each measurement includes the trip through the worker
+ * thread and back to the main loop.
+ */
+static void
+bench_play_full (GSoundContext *ctx)
+{
+  GHashTable *table = make_attrs_table ();
+  BenchResult result;
+  FullData data;
+  gint64 start;
+  int i;
+
+  bench_result_init (&result, "play-fullv-completion", TRUE);
+
+  data.result = &result;
+  data.loop = g_main_loop_new (NULL, FALSE);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      data.pending = 1;
+      data.start = g_get_monotonic_time ();
+      gsound_context_play_fullv (ctx, table, NULL,
+                                 on_play_full_finished, &data);
+      g_main_loop_run (data.loop);
+    }
+  result.total_us = g_get_monotonic_time () - start;
+
+  bench_result_print (&result);
+
+  g_main_loop_unref (data.loop);
+  g_hash_table_unref (table);
+}
+
+/* Synchronous cache requests. The null driver does not cache anything. */
+static void
+bench_cache (GSoundContext *ctx)
+{
+  GHashTable *table = make_attrs_table ();
+  BenchResult result;
+  gint64 start;
+  int i;
+
+  g_hash_table_insert (table, GSOUND_ATTR_CANBERRA_CACHE_CONTROL, "volatile");
+
+  bench_result_init (&result, "cachev", FALSE);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    if (!gsound_context_cachev (ctx, table, NULL))
+      result.errors++;
+  result.total_us = g_get_monotonic_time () - start;
+  result.ops = iterations;
+
+  bench_result_print (&result);
+
+  g_hash_table_unref (table);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *options;
+  GSoundContext *ctx;
+  GError *error = NULL;
+
+  g_set_application_name ("gsound-bench");
+
+  options = g_option_context_new ("- benchmark GSound");
+  g_option_context_add_main_entries (options, entries, NULL);
+  if (!g_option_context_parse (options, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (options);
+
+  if (iterations <= 0)
+    {
+      g_printerr ("The number of iterations must be positive\n");
+      return EXIT_FAILURE;
+    }
+
+  ctx = gsound_context_new (NULL, &error);
+  if (ctx && !gsound_context_set_driver (ctx, driver ? driver : "null", &error))
+    g_clear_object (&ctx);
+  if (ctx && !gsound_context_open (ctx, &error))
+    g_clear_object (&ctx);
+
+  if (!ctx)
+    {
+      g_printerr ("Failed to set up the sound context: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  g_print ("{ \"driver\": \"%s\", \"iterations\": %d, \"benchmarks\": [",
+           driver ? driver : "null", iterations);
+
+  bench_attributes_new ();
+  bench_play_simple (ctx);
+  bench_cancel ();
+  bench_play_full (ctx);
+  bench_cache (ctx);
+
+  g_print ("\n  ] }\n");
+
+  g_object_unref (ctx);
+  g_free (driver);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+/* gsound-attr-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_ATTR_PRIVATE_H
+#define GSOUND_ATTR_PRIVATE_H
+
+#include "gsound-attr.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The number of attribute IDs, for sizing tables. This isn't part of the
+ * public enum so that adding a standard attribute doesn't change the ABI;
+ * keep it in step with the last member of #GSoundAttrId.
+ */
+#define GSOUND_N_ATTR_IDS (GSOUND_ATTR_ID_GSOUND_PRIORITY + 1)
+
+G_END_DECLS
+#endif /* GSOUND_ATTR_PRIVATE_H */
@@ -0,0 +1,300 @@
+/* gsound-attr.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gsound-attr-private.h"
+#include "gsound-context.h"
+
+/* The standard attribute names, indexed by GSoundAttrId */
+static const char * const attr_keys[GSOUND_N_ATTR_IDS] = {
+  NULL,
+  GSOUND_ATTR_MEDIA_NAME,
+  GSOUND_ATTR_MEDIA_TITLE,
+  GSOUND_ATTR_MEDIA_ARTIST,
+  GSOUND_ATTR_MEDIA_LANGUAGE,
+  GSOUND_ATTR_MEDIA_FILENAME,
+  GSOUND_ATTR_MEDIA_ICON,
+  GSOUND_ATTR_MEDIA_ICON_NAME,
+  GSOUND_ATTR_MEDIA_ROLE,
+  GSOUND_ATTR_EVENT_ID,
+  GSOUND_ATTR_EVENT_DESCRIPTION,
+  GSOUND_ATTR_EVENT_MOUSE_X,
+  GSOUND_ATTR_EVENT_MOUSE_Y,
+  GSOUND_ATTR_EVENT_MOUSE_HPOS,
+  GSOUND_ATTR_EVENT_MOUSE_VPOS,
+  GSOUND_ATTR_EVENT_MOUSE_BUTTON,
+  GSOUND_ATTR_WINDOW_NAME,
+  GSOUND_ATTR_WINDOW_ID,
+  GSOUND_ATTR_WINDOW_ICON,
+  GSOUND_ATTR_WINDOW_ICON_NAME,
+  GSOUND_ATTR_WINDOW_X,
+  GSOUND_ATTR_WINDOW_Y,
+  GSOUND_ATTR_WINDOW_WIDTH,
+  GSOUND_ATTR_WINDOW_HEIGHT,
+  GSOUND_ATTR_WINDOW_HPOS,
+  GSOUND_ATTR_WINDOW_VPOS,
+  GSOUND_ATTR_WINDOW_DESKTOP,
+  GSOUND_ATTR_WINDOW_X11_DISPLAY,
+  GSOUND_ATTR_WINDOW_X11_SCREEN,
+  GSOUND_ATTR_WINDOW_X11_MONITOR,
+  GSOUND_ATTR_WINDOW_X11_XID,
+  GSOUND_ATTR_APPLICATION_NAME,
+  GSOUND_ATTR_APPLICATION_ID,
+  GSOUND_ATTR_APPLICATION_VERSION,
+  GSOUND_ATTR_APPLICATION_ICON,
+  GSOUND_ATTR_APPLICATION_ICON_NAME,
+  GSOUND_ATTR_APPLICATION_LANGUAGE,
+  GSOUND_ATTR_APPLICATION_PROCESS_ID,
+  GSOUND_ATTR_APPLICATION_PROCESS_BINARY,
+  GSOUND_ATTR_APPLICATION_PROCESS_USER,
+  GSOUND_ATTR_APPLICATION_PROCESS_HOST,
+  GSOUND_ATTR_CANBERRA_CACHE_CONTROL,
+  GSOUND_ATTR_CANBERRA_VOLUME,
+  GSOUND_ATTR_CANBERRA_XDG_THEME_NAME,
+  GSOUND_ATTR_CANBERRA_XDG_THEME_OUTPUT_PROFILE,
+  GSOUND_ATTR_CANBERRA_ENABLE,
+  GSOUND_ATTR_CANBERRA_FORCE_CHANNEL,
+  GSOUND_ATTR_GSOUND_PRIORITY,
+};
+
+static GHashTable *attr_ids;
+
+static GHashTable *
+gsound_attr_ids_init (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      GHashTable *ids = g_hash_table_new (g_str_hash, g_str_equal);
+      guint i;
+
+      for (i = 1; i < GSOUND_N_ATTR_IDS; i++)
+        g_hash_table_insert (ids, (gpointer) attr_keys[i],
+                             GUINT_TO_POINTER (i));
+
+      attr_ids = ids;
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return attr_ids;
+}
+
+/**
+ * gsound_attr_id_to_key:
+ * @id: A #GSoundAttrId
+ *
+ * Gets the name of the attribute @id, for example "event.id" for
+ * %GSOUND_ATTR_ID_EVENT_ID.
+ *
+ * Returns: (nullable): The name of the attribute, or %NULL if @id is not
+ *   valid
+ */
+const char *
+gsound_attr_id_to_key (GSoundAttrId id)
+{
+  if (id <= GSOUND_ATTR_ID_INVALID || id >= GSOUND_N_ATTR_IDS)
+    return NULL;
+
+  return attr_keys[id];
+}
+
+/**
+ * gsound_attr_id_from_key:
+ * @key: The name of an attribute
+ *
+ * Looks up the ID of the standard attribute called @key.
+ *
+ * Returns: The #GSoundAttrId of @key, or %GSOUND_ATTR_ID_INVALID if it is
+ *   not one of the standard attributes
+ */
+GSoundAttrId
+gsound_attr_id_from_key (const char *key)
+{
+  g_return_val_if_fail (key != NULL, GSOUND_ATTR_ID_INVALID);
+
+  return GPOINTER_TO_UINT (g_hash_table_lookup (gsound_attr_ids_init (), key));
+}
+
+/* The longest attribute name the sound server accepts, including the nul */
+#define MAX_KEY_LENGTH 256
+
+static const char * const cache_control_values[] = {
+  "permanent", "volatile", "never", NULL
+};
+
+static const char * const enable_values[] = { "0", "1", NULL };
+
+static const char * const priority_values[] = {
+  "low", "normal", "high", NULL
+};
+
+static const char * const channel_values[] = {
+  "mono", "front-left", "front-right", "front-center", "rear-left",
+  "rear-right", "rear-center", "lfe", "front-left-of-center",
+  "front-right-of-center", "side-left", "side-right", "top-center",
+  "top-front-left", "top-front-right", "top-front-center", "top-rear-left",
+  "top-rear-right", "top-rear-center", NULL
+};
+
+static gboolean
+value_is_integer (const char *value)
+{
+  char *end;
+
+  if (!*value)
+    return FALSE;
+
+  g_ascii_strtoll (value, &end, 10);
+
+  return *end == '\0';
+}
+
+static gboolean
+value_is_double (const char *value,
+                 gdouble     min,
+                 gdouble     max)
+{
+  gdouble d;
+  char *end;
+
+  if (!*value)
+    return FALSE;
+
+  d = g_ascii_strtod (value, &end);
+
+  return *end == '\0' && d >= min && d <= max;
+}
+
+static gboolean
+value_is_one_of (const char         *value,
+                 const char * const *values)
+{
+  for (; *values; values++)
+    if (g_str_equal (*values, value))
+      return TRUE;
+
+  return FALSE;
+}
+
+/**
+ * gsound_attr_validate:
+ * @key: The name of an attribute
+ * @value: The value to check
+ * @error: Return location for error, or %NULL
+ *
+ * Checks that @value is acceptable for the attribute @key. The name must be
+ * printable ASCII and the value valid UTF-8, and the standard attributes
+ * which take a number or one of a fixed set of strings, such as
+ * #GSOUND_ATTR_WINDOW_X or #GSOUND_ATTR_CANBERRA_CACHE_CONTROL, must have
+ * one. Other attributes may have any value.
+ *
+ * GSound does this itself for every attribute it is given, so you only need
+ * to call it to check input of your own, such as from a configuration file.
+ *
+ * Returns: %TRUE if @value is acceptable, or %FALSE with @error set to
+ *   %GSOUND_ERROR_INVALID
+ */
+gboolean
+gsound_attr_validate (const char *key,
+                      const char *value,
+                      GError    **error)
+{
+  const char *p;
+  gboolean valid;
+
+  g_return_val_if_fail (key != NULL, FALSE);
+
+  if (!value)
+    {
+      g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                   "No value given for attribute \"%s\"", key);
+      return FALSE;
+    }
+
+  for (p = key; *p; p++)
+    if (!g_ascii_isgraph (*p))
+      break;
+
+  if (*p || p == key || p - key >= MAX_KEY_LENGTH)
+    {
+      g_set_error_literal (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                           "Attribute names must be non-empty, printable "
+                           "ASCII and shorter than 256 characters");
+      return FALSE;
+    }
+
+  if (!g_utf8_validate (value, -1, NULL))
+    {
+      g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                   "The value of attribute \"%s\" is not valid UTF-8", key);
+      return FALSE;
+    }
+
+  switch (gsound_attr_id_from_key (key))
+    {
+    case GSOUND_ATTR_ID_EVENT_MOUSE_X:
+    case GSOUND_ATTR_ID_EVENT_MOUSE_Y:
+    case GSOUND_ATTR_ID_EVENT_MOUSE_BUTTON:
+    case GSOUND_ATTR_ID_WINDOW_X:
+    case GSOUND_ATTR_ID_WINDOW_Y:
+    case GSOUND_ATTR_ID_WINDOW_WIDTH:
+    case GSOUND_ATTR_ID_WINDOW_HEIGHT:
+    case GSOUND_ATTR_ID_WINDOW_X11_SCREEN:
+    case GSOUND_ATTR_ID_WINDOW_X11_MONITOR:
+    case GSOUND_ATTR_ID_APPLICATION_PROCESS_ID:
+      valid = value_is_integer (value);
+      break;
+    case GSOUND_ATTR_ID_EVENT_MOUSE_HPOS:
+    case GSOUND_ATTR_ID_EVENT_MOUSE_VPOS:
+    case GSOUND_ATTR_ID_WINDOW_HPOS:
+    case GSOUND_ATTR_ID_WINDOW_VPOS:
+      valid = value_is_double (value, 0.0, 1.0);
+      break;
+    case GSOUND_ATTR_ID_CANBERRA_VOLUME:
+      valid = value_is_double (value, -G_MAXDOUBLE, G_MAXDOUBLE);
+      break;
+    case GSOUND_ATTR_ID_CANBERRA_CACHE_CONTROL:
+      valid = value_is_one_of (value, cache_control_values);
+      break;
+    case GSOUND_ATTR_ID_CANBERRA_ENABLE:
+      valid = value_is_one_of (value, enable_values);
+      break;
+    case GSOUND_ATTR_ID_CANBERRA_FORCE_CHANNEL:
+      valid = value_is_one_of (value, channel_values);
+      break;
+    case GSOUND_ATTR_ID_GSOUND_PRIORITY:
+      valid = value_is_one_of (value, priority_values);
+      break;
+    case GSOUND_ATTR_ID_MEDIA_FILENAME:
+    case GSOUND_ATTR_ID_EVENT_ID:
+      valid = *value != '\0';
+      break;
+    default:
+      valid = TRUE;
+      break;
+    }
+
+  if (!valid)
+    {
+      g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                   "Invalid value \"%s\" for attribute \"%s\"", value, key);
+      return FALSE;
+    }
+
+  return TRUE;
+}
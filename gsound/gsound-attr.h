@@ -35,6 +35,15 @@ G_BEGIN_DECLS
  * 
  * Attributes which can be applied to a #GSoundContext or passed to one of
  * the `play()` or `cache()` methods.
+ *
+ * Each of the standard attributes also has a #GSoundAttrId, which can be
+ * used with gsound_attributes_new_from_ids() and
+ * gsound_context_play_simple_ids(). Attributes with any other name can
+ * still be given as strings everywhere else.
+ *
+ * Every attribute is checked with gsound_attr_validate() before it is
+ * passed on, so a bad value is reported with a #GSoundError straight away
+ * rather than being sent to the sound server.
  */
 
 /**
@@ -460,7 +469,134 @@ G_BEGIN_DECLS
  */
 #define GSOUND_ATTR_CANBERRA_FORCE_CHANNEL            "canberra.force_channel"
 
-
+/**
+ * GSOUND_ATTR_GSOUND_PRIORITY:
+ *
+ * How important the sound is, one of "low", "normal" or "high". This is
+ * used to decide which sound to stop when a #GSoundContext has more
+ * sounds to play than voices; see gsound_context_set_max_voices(). If not
+ * given, the priority is guessed from #GSOUND_ATTR_MEDIA_ROLE.
+ *
+ * This attribute is only used by GSound itself.
+ */
+#define GSOUND_ATTR_GSOUND_PRIORITY                    "gsound.priority"
+
+
+/**
+ * GSoundAttrId:
+ * @GSOUND_ATTR_ID_INVALID: Not an attribute; ends lists of attribute IDs
+ * @GSOUND_ATTR_ID_MEDIA_NAME: #GSOUND_ATTR_MEDIA_NAME
+ * @GSOUND_ATTR_ID_MEDIA_TITLE: #GSOUND_ATTR_MEDIA_TITLE
+ * @GSOUND_ATTR_ID_MEDIA_ARTIST: #GSOUND_ATTR_MEDIA_ARTIST
+ * @GSOUND_ATTR_ID_MEDIA_LANGUAGE: #GSOUND_ATTR_MEDIA_LANGUAGE
+ * @GSOUND_ATTR_ID_MEDIA_FILENAME: #GSOUND_ATTR_MEDIA_FILENAME
+ * @GSOUND_ATTR_ID_MEDIA_ICON: #GSOUND_ATTR_MEDIA_ICON
+ * @GSOUND_ATTR_ID_MEDIA_ICON_NAME: #GSOUND_ATTR_MEDIA_ICON_NAME
+ * @GSOUND_ATTR_ID_MEDIA_ROLE: #GSOUND_ATTR_MEDIA_ROLE
+ * @GSOUND_ATTR_ID_EVENT_ID: #GSOUND_ATTR_EVENT_ID
+ * @GSOUND_ATTR_ID_EVENT_DESCRIPTION: #GSOUND_ATTR_EVENT_DESCRIPTION
+ * @GSOUND_ATTR_ID_EVENT_MOUSE_X: #GSOUND_ATTR_EVENT_MOUSE_X
+ * @GSOUND_ATTR_ID_EVENT_MOUSE_Y: #GSOUND_ATTR_EVENT_MOUSE_Y
+ * @GSOUND_ATTR_ID_EVENT_MOUSE_HPOS: #GSOUND_ATTR_EVENT_MOUSE_HPOS
+ * @GSOUND_ATTR_ID_EVENT_MOUSE_VPOS: #GSOUND_ATTR_EVENT_MOUSE_VPOS
+ * @GSOUND_ATTR_ID_EVENT_MOUSE_BUTTON: #GSOUND_ATTR_EVENT_MOUSE_BUTTON
+ * @GSOUND_ATTR_ID_WINDOW_NAME: #GSOUND_ATTR_WINDOW_NAME
+ * @GSOUND_ATTR_ID_WINDOW_ID: #GSOUND_ATTR_WINDOW_ID
+ * @GSOUND_ATTR_ID_WINDOW_ICON: #GSOUND_ATTR_WINDOW_ICON
+ * @GSOUND_ATTR_ID_WINDOW_ICON_NAME: #GSOUND_ATTR_WINDOW_ICON_NAME
+ * @GSOUND_ATTR_ID_WINDOW_X: #GSOUND_ATTR_WINDOW_X
+ * @GSOUND_ATTR_ID_WINDOW_Y: #GSOUND_ATTR_WINDOW_Y
+ * @GSOUND_ATTR_ID_WINDOW_WIDTH: #GSOUND_ATTR_WINDOW_WIDTH
+ * @GSOUND_ATTR_ID_WINDOW_HEIGHT: #GSOUND_ATTR_WINDOW_HEIGHT
+ * @GSOUND_ATTR_ID_WINDOW_HPOS: #GSOUND_ATTR_WINDOW_HPOS
+ * @GSOUND_ATTR_ID_WINDOW_VPOS: #GSOUND_ATTR_WINDOW_VPOS
+ * @GSOUND_ATTR_ID_WINDOW_DESKTOP: #GSOUND_ATTR_WINDOW_DESKTOP
+ * @GSOUND_ATTR_ID_WINDOW_X11_DISPLAY: #GSOUND_ATTR_WINDOW_X11_DISPLAY
+ * @GSOUND_ATTR_ID_WINDOW_X11_SCREEN: #GSOUND_ATTR_WINDOW_X11_SCREEN
+ * @GSOUND_ATTR_ID_WINDOW_X11_MONITOR: #GSOUND_ATTR_WINDOW_X11_MONITOR
+ * @GSOUND_ATTR_ID_WINDOW_X11_XID: #GSOUND_ATTR_WINDOW_X11_XID
+ * @GSOUND_ATTR_ID_APPLICATION_NAME: #GSOUND_ATTR_APPLICATION_NAME
+ * @GSOUND_ATTR_ID_APPLICATION_ID: #GSOUND_ATTR_APPLICATION_ID
+ * @GSOUND_ATTR_ID_APPLICATION_VERSION: #GSOUND_ATTR_APPLICATION_VERSION
+ * @GSOUND_ATTR_ID_APPLICATION_ICON: #GSOUND_ATTR_APPLICATION_ICON
+ * @GSOUND_ATTR_ID_APPLICATION_ICON_NAME: #GSOUND_ATTR_APPLICATION_ICON_NAME
+ * @GSOUND_ATTR_ID_APPLICATION_LANGUAGE: #GSOUND_ATTR_APPLICATION_LANGUAGE
+ * @GSOUND_ATTR_ID_APPLICATION_PROCESS_ID: #GSOUND_ATTR_APPLICATION_PROCESS_ID
+ * @GSOUND_ATTR_ID_APPLICATION_PROCESS_BINARY: #GSOUND_ATTR_APPLICATION_PROCESS_BINARY
+ * @GSOUND_ATTR_ID_APPLICATION_PROCESS_USER: #GSOUND_ATTR_APPLICATION_PROCESS_USER
+ * @GSOUND_ATTR_ID_APPLICATION_PROCESS_HOST: #GSOUND_ATTR_APPLICATION_PROCESS_HOST
+ * @GSOUND_ATTR_ID_CANBERRA_CACHE_CONTROL: #GSOUND_ATTR_CANBERRA_CACHE_CONTROL
+ * @GSOUND_ATTR_ID_CANBERRA_VOLUME: #GSOUND_ATTR_CANBERRA_VOLUME
+ * @GSOUND_ATTR_ID_CANBERRA_XDG_THEME_NAME: #GSOUND_ATTR_CANBERRA_XDG_THEME_NAME
+ * @GSOUND_ATTR_ID_CANBERRA_XDG_THEME_OUTPUT_PROFILE: #GSOUND_ATTR_CANBERRA_XDG_THEME_OUTPUT_PROFILE
+ * @GSOUND_ATTR_ID_CANBERRA_ENABLE: #GSOUND_ATTR_CANBERRA_ENABLE
+ * @GSOUND_ATTR_ID_CANBERRA_FORCE_CHANNEL: #GSOUND_ATTR_CANBERRA_FORCE_CHANNEL
+ * @GSOUND_ATTR_ID_GSOUND_PRIORITY: #GSOUND_ATTR_GSOUND_PRIORITY
+ *
+ * A numeric ID for each of the standard attributes. Passing these to
+ * gsound_attributes_new_from_ids() or gsound_context_play_simple_ids()
+ * instead of the attribute names saves GSound from having to look the
+ * names up.
+ */
+typedef enum
+{
+  GSOUND_ATTR_ID_INVALID,
+  GSOUND_ATTR_ID_MEDIA_NAME,
+  GSOUND_ATTR_ID_MEDIA_TITLE,
+  GSOUND_ATTR_ID_MEDIA_ARTIST,
+  GSOUND_ATTR_ID_MEDIA_LANGUAGE,
+  GSOUND_ATTR_ID_MEDIA_FILENAME,
+  GSOUND_ATTR_ID_MEDIA_ICON,
+  GSOUND_ATTR_ID_MEDIA_ICON_NAME,
+  GSOUND_ATTR_ID_MEDIA_ROLE,
+  GSOUND_ATTR_ID_EVENT_ID,
+  GSOUND_ATTR_ID_EVENT_DESCRIPTION,
+  GSOUND_ATTR_ID_EVENT_MOUSE_X,
+  GSOUND_ATTR_ID_EVENT_MOUSE_Y,
+  GSOUND_ATTR_ID_EVENT_MOUSE_HPOS,
+  GSOUND_ATTR_ID_EVENT_MOUSE_VPOS,
+  GSOUND_ATTR_ID_EVENT_MOUSE_BUTTON,
+  GSOUND_ATTR_ID_WINDOW_NAME,
+  GSOUND_ATTR_ID_WINDOW_ID,
+  GSOUND_ATTR_ID_WINDOW_ICON,
+  GSOUND_ATTR_ID_WINDOW_ICON_NAME,
+  GSOUND_ATTR_ID_WINDOW_X,
+  GSOUND_ATTR_ID_WINDOW_Y,
+  GSOUND_ATTR_ID_WINDOW_WIDTH,
+  GSOUND_ATTR_ID_WINDOW_HEIGHT,
+  GSOUND_ATTR_ID_WINDOW_HPOS,
+  GSOUND_ATTR_ID_WINDOW_VPOS,
+  GSOUND_ATTR_ID_WINDOW_DESKTOP,
+  GSOUND_ATTR_ID_WINDOW_X11_DISPLAY,
+  GSOUND_ATTR_ID_WINDOW_X11_SCREEN,
+  GSOUND_ATTR_ID_WINDOW_X11_MONITOR,
+  GSOUND_ATTR_ID_WINDOW_X11_XID,
+  GSOUND_ATTR_ID_APPLICATION_NAME,
+  GSOUND_ATTR_ID_APPLICATION_ID,
+  GSOUND_ATTR_ID_APPLICATION_VERSION,
+  GSOUND_ATTR_ID_APPLICATION_ICON,
+  GSOUND_ATTR_ID_APPLICATION_ICON_NAME,
+  GSOUND_ATTR_ID_APPLICATION_LANGUAGE,
+  GSOUND_ATTR_ID_APPLICATION_PROCESS_ID,
+  GSOUND_ATTR_ID_APPLICATION_PROCESS_BINARY,
+  GSOUND_ATTR_ID_APPLICATION_PROCESS_USER,
+  GSOUND_ATTR_ID_APPLICATION_PROCESS_HOST,
+  GSOUND_ATTR_ID_CANBERRA_CACHE_CONTROL,
+  GSOUND_ATTR_ID_CANBERRA_VOLUME,
+  GSOUND_ATTR_ID_CANBERRA_XDG_THEME_NAME,
+  GSOUND_ATTR_ID_CANBERRA_XDG_THEME_OUTPUT_PROFILE,
+  GSOUND_ATTR_ID_CANBERRA_ENABLE,
+  GSOUND_ATTR_ID_CANBERRA_FORCE_CHANNEL,
+  GSOUND_ATTR_ID_GSOUND_PRIORITY
+} GSoundAttrId;
+
+const char   *gsound_attr_id_to_key   (GSoundAttrId  id);
+
+GSoundAttrId  gsound_attr_id_from_key (const char   *key);
+
+gboolean      gsound_attr_validate    (const char   *key,
+                                       const char   *value,
+                                       GError      **error);
 
 G_END_DECLS
 
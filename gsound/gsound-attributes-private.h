@@ -0,0 +1,41 @@
+/* gsound-attributes-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_ATTRIBUTES_PRIVATE_H
+#define GSOUND_ATTRIBUTES_PRIVATE_H
+
+#include "gsound-attributes.h"
+
+#include <canberra.h>
+
+#include <stdarg.h>
+
+G_BEGIN_DECLS
+
+GSoundAttributes *_gsound_attributes_new_valist    (GError           **error,
+                                                    va_list            args);
+
+ca_proplist      *_gsound_attributes_get_proplist  (GSoundAttributes  *attrs);
+
+GHashTable       *_gsound_attributes_get_table     (GSoundAttributes  *attrs);
+
+int               _gsound_attributes_copy_to_proplist (GSoundAttributes *attrs,
+                                                       ca_proplist      *pl);
+
+G_END_DECLS
+#endif /* GSOUND_ATTRIBUTES_PRIVATE_H */
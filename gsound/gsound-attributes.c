@@ -0,0 +1,405 @@
+/* gsound-attributes.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * SECTION: gsound-attributes
+ * @title: GSoundAttributes
+ * @short_description: Reusable, prebuilt attribute sets
+ * @see_also: #GSoundContext
+ *
+ * A #GSoundAttributes is an immutable, reference-counted set of attributes
+ * which can be built once and then passed to gsound_context_play_attrs(),
+ * gsound_context_play_attrs_full() or gsound_context_cache_attrs() as many
+ * times as you like.
+ *
+ * The attributes are converted into the form used by the sound server when
+ * the set is created, rather than on every call, which makes this the
+ * cheapest way to play the same sound repeatedly. For example, an
+ * application which plays a notification sound every time a message
+ * arrives might do something like the following (error checking omitted):
+ *
+ * |[<!-- language="C" -->
+ * GSoundAttributes *message_sound;
+ *
+ * message_sound = gsound_attributes_new (NULL,
+ *                                        GSOUND_ATTR_EVENT_ID, "message-new-instant",
+ *                                        NULL);
+ *
+ * // ...and then, each time a message arrives
+ * gsound_context_play_attrs (ctx, message_sound, NULL, NULL);
+ * ]|
+ *
+ * Since a #GSoundAttributes cannot be modified once created, it is safe to
+ * share between threads.
+ */
+
+#include "gsound-attr-private.h"
+#include "gsound-attributes-private.h"
+#include "gsound-context.h"
+
+#include <stdarg.h>
+
+struct _GSoundAttributes
+{
+  volatile gint  ref_count;
+
+  ca_proplist   *proplist;
+  GHashTable    *table;
+
+  /* The values of the standard attributes, owned by @table */
+  const char    *known[GSOUND_N_ATTR_IDS];
+};
+
+G_DEFINE_BOXED_TYPE (GSoundAttributes, gsound_attributes,
+                     gsound_attributes_ref, gsound_attributes_unref)
+
+static GSoundAttributes *
+gsound_attributes_alloc (GError **error)
+{
+  GSoundAttributes *attrs;
+  int res;
+
+  attrs = g_slice_new0 (GSoundAttributes);
+  attrs->ref_count = 1;
+
+  res = ca_proplist_create (&attrs->proplist);
+  if (res != CA_SUCCESS)
+    {
+      g_set_error_literal (error, GSOUND_ERROR, res, ca_strerror (res));
+      g_slice_free (GSoundAttributes, attrs);
+      return NULL;
+    }
+
+  attrs->table = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, g_free);
+
+  return attrs;
+}
+
+/* @id is the ID of @key, or GSOUND_ATTR_ID_INVALID if not known yet */
+static gboolean
+gsound_attributes_add (GSoundAttributes *attrs,
+                       GSoundAttrId      id,
+                       const char       *key,
+                       const char       *value,
+                       GError          **error)
+{
+  gchar *copy;
+  int res;
+
+  /* Checked once here, so sets can be played many times without it */
+  if (!gsound_attr_validate (key, value, error))
+    return FALSE;
+
+  res = ca_proplist_sets (attrs->proplist, key, value);
+  if (res != CA_SUCCESS)
+    {
+      g_set_error_literal (error, GSOUND_ERROR, res, ca_strerror (res));
+      return FALSE;
+    }
+
+  copy = g_strdup (value);
+  g_hash_table_replace (attrs->table, g_strdup (key), copy);
+
+  if (id == GSOUND_ATTR_ID_INVALID)
+    id = gsound_attr_id_from_key (key);
+  if (id != GSOUND_ATTR_ID_INVALID)
+    attrs->known[id] = copy;
+
+  return TRUE;
+}
+
+/**
+ * gsound_attributes_new: (skip)
+ * @error: Return location for error
+ * @...: %NULL terminated list of attribute name-value pairs
+ *
+ * Creates a new #GSoundAttributes holding the given attributes. If an error
+ * occurs (for example, an attribute has no value), %NULL is returned and
+ * @error is set appropriately.
+ *
+ * Returns: (transfer full): A new #GSoundAttributes, or %NULL
+ */
+GSoundAttributes *
+gsound_attributes_new (GError **error, ...)
+{
+  GSoundAttributes *attrs;
+  va_list args;
+
+  va_start (args, error);
+  attrs = _gsound_attributes_new_valist (error, args);
+  va_end (args);
+
+  return attrs;
+}
+
+GSoundAttributes *
+_gsound_attributes_new_valist (GError **error,
+                               va_list  args)
+{
+  GSoundAttributes *attrs;
+
+  attrs = gsound_attributes_alloc (error);
+  if (!attrs)
+    return NULL;
+
+  while (TRUE)
+    {
+      const char *key;
+      const char *val;
+
+      key = va_arg (args, const char*);
+      if (!key)
+        break;
+
+      val = va_arg (args, const char*);
+      if (!val)
+        {
+          g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                       "No value given for attribute \"%s\"", key);
+          g_clear_pointer (&attrs, gsound_attributes_unref);
+          break;
+        }
+
+      if (!gsound_attributes_add (attrs, GSOUND_ATTR_ID_INVALID,
+                                  key, val, error))
+        {
+          g_clear_pointer (&attrs, gsound_attributes_unref);
+          break;
+        }
+    }
+
+  return attrs;
+}
+
+/**
+ * gsound_attributes_new_from_ids: (skip)
+ * @error: Return location for error
+ * @...: A list of #GSoundAttrId and value pairs, terminated by
+ *   %GSOUND_ATTR_ID_INVALID
+ *
+ * Creates a new #GSoundAttributes holding the given standard attributes,
+ * which are identified by #GSoundAttrId rather than by name. For example
+ *
+ * |[<!-- language="C" -->
+ * attrs = gsound_attributes_new_from_ids (&error,
+ *                                         GSOUND_ATTR_ID_EVENT_ID, "bell",
+ *                                         GSOUND_ATTR_ID_INVALID);
+ * ]|
+ *
+ * Returns: (transfer full): A new #GSoundAttributes, or %NULL
+ */
+GSoundAttributes *
+gsound_attributes_new_from_ids (GError **error, ...)
+{
+  GSoundAttributes *attrs;
+  va_list args;
+
+  attrs = gsound_attributes_alloc (error);
+  if (!attrs)
+    return NULL;
+
+  va_start (args, error);
+  while (TRUE)
+    {
+      GSoundAttrId id;
+      const char *key;
+      const char *val;
+
+      id = va_arg (args, GSoundAttrId);
+      if (id == GSOUND_ATTR_ID_INVALID)
+        break;
+
+      key = gsound_attr_id_to_key (id);
+      if (!key)
+        {
+          g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                       "Invalid attribute ID %d", id);
+          g_clear_pointer (&attrs, gsound_attributes_unref);
+          break;
+        }
+
+      val = va_arg (args, const char*);
+      if (!val)
+        {
+          g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                       "No value given for attribute \"%s\"", key);
+          g_clear_pointer (&attrs, gsound_attributes_unref);
+          break;
+        }
+
+      if (!gsound_attributes_add (attrs, id, key, val, error))
+        {
+          g_clear_pointer (&attrs, gsound_attributes_unref);
+          break;
+        }
+    }
+  va_end (args);
+
+  return attrs;
+}
+
+/**
+ * gsound_attributes_newv: (rename-to gsound_attributes_new)
+ * @attrs: (element-type utf8 utf8): Hash table of attributes
+ * @error: Return location for error, or %NULL
+ *
+ * Creates a new #GSoundAttributes holding the attributes in @attrs.
+ *
+ * This function is intented to be used by language bindings.
+ *
+ * Returns: (transfer full): A new #GSoundAttributes, or %NULL
+ */
+GSoundAttributes *
+gsound_attributes_newv (GHashTable *attrs,
+                        GError    **error)
+{
+  GSoundAttributes *self;
+  gpointer key, value;
+  GHashTableIter iter;
+
+  g_return_val_if_fail (attrs != NULL, NULL);
+
+  self = gsound_attributes_alloc (error);
+  if (!self)
+    return NULL;
+
+  g_hash_table_iter_init (&iter, attrs);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (!gsound_attributes_add (self, GSOUND_ATTR_ID_INVALID,
+                                  key, value, error))
+        {
+          gsound_attributes_unref (self);
+          return NULL;
+        }
+    }
+
+  return self;
+}
+
+/**
+ * gsound_attributes_ref:
+ * @attrs: A #GSoundAttributes
+ *
+ * Atomically increments the reference count of @attrs by one.
+ *
+ * Returns: (transfer full): @attrs
+ */
+GSoundAttributes *
+gsound_attributes_ref (GSoundAttributes *attrs)
+{
+  g_return_val_if_fail (attrs != NULL, NULL);
+
+  g_atomic_int_inc (&attrs->ref_count);
+
+  return attrs;
+}
+
+/**
+ * gsound_attributes_unref:
+ * @attrs: A #GSoundAttributes
+ *
+ * Atomically decrements the reference count of @attrs by one. When the
+ * reference count drops to zero, all memory used by @attrs is released.
+ */
+void
+gsound_attributes_unref (GSoundAttributes *attrs)
+{
+  g_return_if_fail (attrs != NULL);
+
+  if (!g_atomic_int_dec_and_test (&attrs->ref_count))
+    return;
+
+  g_clear_pointer (&attrs->proplist, ca_proplist_destroy);
+  g_clear_pointer (&attrs->table, g_hash_table_unref);
+
+  g_slice_free (GSoundAttributes, attrs);
+}
+
+/**
+ * gsound_attributes_lookup:
+ * @attrs: A #GSoundAttributes
+ * @key: The attribute to look up, for example #GSOUND_ATTR_EVENT_ID
+ *
+ * Looks up the value of the attribute @key in @attrs.
+ *
+ * Returns: (nullable): The value of @key, or %NULL if it is not set
+ */
+const char *
+gsound_attributes_lookup (GSoundAttributes *attrs,
+                          const char       *key)
+{
+  g_return_val_if_fail (attrs != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  return g_hash_table_lookup (attrs->table, key);
+}
+
+/**
+ * gsound_attributes_lookup_id:
+ * @attrs: A #GSoundAttributes
+ * @id: The standard attribute to look up
+ *
+ * Looks up the value of the standard attribute @id in @attrs. This is
+ * quicker than gsound_attributes_lookup(), as no hashing is needed.
+ *
+ * Returns: (nullable): The value of @id, or %NULL if it is not set
+ */
+const char *
+gsound_attributes_lookup_id (GSoundAttributes *attrs,
+                             GSoundAttrId      id)
+{
+  g_return_val_if_fail (attrs != NULL, NULL);
+  g_return_val_if_fail (id > GSOUND_ATTR_ID_INVALID &&
+                        id < GSOUND_N_ATTR_IDS, NULL);
+
+  return attrs->known[id];
+}
+
+/* Adds all of the attributes in @attrs to @pl */
+int
+_gsound_attributes_copy_to_proplist (GSoundAttributes *attrs,
+                                     ca_proplist      *pl)
+{
+  gpointer key, value;
+  GHashTableIter iter;
+
+  g_hash_table_iter_init (&iter, attrs->table);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      int res = ca_proplist_sets (pl, key, value);
+
+      if (res != CA_SUCCESS)
+        return res;
+    }
+
+  return CA_SUCCESS;
+}
+
+ca_proplist *
+_gsound_attributes_get_proplist (GSoundAttributes *attrs)
+{
+  return attrs->proplist;
+}
+
+/* The attributes as a table of name to value; don't modify it */
+GHashTable *
+_gsound_attributes_get_table (GSoundAttributes *attrs)
+{
+  return attrs->table;
+}
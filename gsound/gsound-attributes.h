@@ -0,0 +1,52 @@
+/* gsound-attributes.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_ATTRIBUTES_H
+#define GSOUND_ATTRIBUTES_H
+
+#include <gio/gio.h>
+
+#include "gsound-attr.h"
+
+G_BEGIN_DECLS
+#define GSOUND_TYPE_ATTRIBUTES           (gsound_attributes_get_type ())
+typedef struct _GSoundAttributes GSoundAttributes;
+
+GType             gsound_attributes_get_type       (void);
+
+GSoundAttributes *gsound_attributes_new            (GError           **error,
+                                                    ...) G_GNUC_NULL_TERMINATED;
+
+GSoundAttributes *gsound_attributes_newv           (GHashTable        *attrs,
+                                                    GError           **error);
+
+GSoundAttributes *gsound_attributes_new_from_ids   (GError           **error,
+                                                    ...);
+
+GSoundAttributes *gsound_attributes_ref            (GSoundAttributes  *attrs);
+
+void              gsound_attributes_unref          (GSoundAttributes  *attrs);
+
+const char       *gsound_attributes_lookup         (GSoundAttributes  *attrs,
+                                                    const char        *key);
+
+const char       *gsound_attributes_lookup_id      (GSoundAttributes  *attrs,
+                                                    GSoundAttrId       id);
+
+G_END_DECLS
+#endif /* GSOUND_ATTRIBUTES_H */
@@ -0,0 +1,79 @@
+/* gsound-bank-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_BANK_PRIVATE_H
+#define GSOUND_BANK_PRIVATE_H
+
+#include "gsound-context.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A sample bank is a single file holding many pre-decoded sounds, laid out
+ * so that it can be mapped into memory and each sound's PCM data sliced
+ * out without parsing. Everything is little-endian:
+ *
+ *   GSoundBankHeader
+ *   GSoundBankEntry[n_entries]
+ *   NUL-terminated event IDs
+ *   PCM data, each sound aligned to GSOUND_BANK_ALIGNMENT bytes
+ *
+ * Offsets are from the start of the file. Banks are written by the
+ * gsound-make-bank tool.
+ */
+
+#define GSOUND_BANK_MAGIC      "GSNDBANK"
+#define GSOUND_BANK_VERSION    1
+#define GSOUND_BANK_ALIGNMENT  16
+
+typedef struct
+{
+  char    magic[8];
+  guint32 version;
+  guint32 n_entries;
+} GSoundBankHeader;
+
+typedef struct
+{
+  guint32 name_offset;
+  guint32 format;
+  guint32 rate;
+  guint32 channels;
+  guint64 data_offset;
+  guint64 data_size;
+} GSoundBankEntry;
+
+G_STATIC_ASSERT (sizeof (GSoundBankHeader) == 16);
+G_STATIC_ASSERT (sizeof (GSoundBankEntry) == 32);
+
+typedef struct _GSoundBank GSoundBank;
+
+GSoundBank *_gsound_bank_open          (const char        *filename,
+                                        GError           **error);
+
+void        _gsound_bank_free          (GSoundBank        *bank);
+
+guint       _gsound_bank_get_n_entries (GSoundBank        *bank);
+
+GBytes     *_gsound_bank_get_entry     (GSoundBank        *bank,
+                                        guint              index,
+                                        const char       **event_id,
+                                        GSoundSampleSpec  *spec);
+
+G_END_DECLS
+#endif /* GSOUND_BANK_PRIVATE_H */
@@ -0,0 +1,156 @@
+/* gsound-bank.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gsound-bank-private.h"
+
+#include <string.h>
+
+struct _GSoundBank
+{
+  GMappedFile *mapped;
+  GBytes      *bytes;
+
+  const GSoundBankEntry *entries;
+  guint                  n_entries;
+};
+
+static gboolean
+entry_is_valid (const GSoundBankEntry *entry,
+                const guint8          *data,
+                gsize                  size)
+{
+  guint64 offset = GUINT64_FROM_LE (entry->data_offset);
+  guint64 length = GUINT64_FROM_LE (entry->data_size);
+  guint32 name = GUINT32_FROM_LE (entry->name_offset);
+
+  switch (GUINT32_FROM_LE (entry->format))
+    {
+    case GSOUND_SAMPLE_FORMAT_U8:
+    case GSOUND_SAMPLE_FORMAT_S16LE:
+      break;
+    default:
+      return FALSE;
+    }
+
+  if (entry->rate == 0 || entry->channels == 0)
+    return FALSE;
+
+  if (offset > size || length > size - offset)
+    return FALSE;
+
+  /* The name must be terminated within the file */
+  return name < size && memchr (data + name, '\0', size - name) != NULL;
+}
+
+/*
+ * Maps the bank in @filename and checks that its index is sane, so that
+ * the entries can be used without further checks.
+ */
+GSoundBank *
+_gsound_bank_open (const char  *filename,
+                   GError     **error)
+{
+  const GSoundBankHeader *header;
+  GSoundBank *bank;
+  const guint8 *data;
+  guint32 n_entries;
+  gsize size;
+  guint i;
+
+  bank = g_slice_new0 (GSoundBank);
+
+  bank->mapped = g_mapped_file_new (filename, FALSE, error);
+  if (!bank->mapped)
+    {
+      g_slice_free (GSoundBank, bank);
+      return NULL;
+    }
+
+  bank->bytes = g_mapped_file_get_bytes (bank->mapped);
+  data = g_bytes_get_data (bank->bytes, &size);
+  header = (const GSoundBankHeader *) data;
+
+  if (size < sizeof *header ||
+      memcmp (header->magic, GSOUND_BANK_MAGIC, sizeof header->magic) != 0 ||
+      GUINT32_FROM_LE (header->version) != GSOUND_BANK_VERSION)
+    goto invalid;
+
+  n_entries = GUINT32_FROM_LE (header->n_entries);
+  if (n_entries > (size - sizeof *header) / sizeof (GSoundBankEntry))
+    goto invalid;
+
+  bank->entries = (const GSoundBankEntry *) (data + sizeof *header);
+  bank->n_entries = n_entries;
+
+  for (i = 0; i < n_entries; i++)
+    {
+      if (!entry_is_valid (&bank->entries[i], data, size))
+        goto invalid;
+    }
+
+  return bank;
+
+invalid:
+  g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_CORRUPT,
+               "\"%s\" is not a valid sample bank", filename);
+  _gsound_bank_free (bank);
+  return NULL;
+}
+
+void
+_gsound_bank_free (GSoundBank *bank)
+{
+  g_clear_pointer (&bank->bytes, g_bytes_unref);
+  g_clear_pointer (&bank->mapped, g_mapped_file_unref);
+  g_slice_free (GSoundBank, bank);
+}
+
+guint
+_gsound_bank_get_n_entries (GSoundBank *bank)
+{
+  return bank->n_entries;
+}
+
+/*
+ * Returns the PCM data of entry @index, without copying it, and fills in
+ * its event ID and format. The event ID belongs to @bank.
+ */
+GBytes *
+_gsound_bank_get_entry (GSoundBank        *bank,
+                        guint              index,
+                        const char       **event_id,
+                        GSoundSampleSpec  *spec)
+{
+  const GSoundBankEntry *entry;
+  const guint8 *data;
+
+  g_return_val_if_fail (index < bank->n_entries, NULL);
+
+  entry = &bank->entries[index];
+  data = g_bytes_get_data (bank->bytes, NULL);
+
+  *event_id = (const char *) data + GUINT32_FROM_LE (entry->name_offset);
+
+  spec->format = GUINT32_FROM_LE (entry->format);
+  spec->rate = GUINT32_FROM_LE (entry->rate);
+  spec->channels = GUINT32_FROM_LE (entry->channels);
+
+  return g_bytes_new_from_bytes (bank->bytes,
+                                 GUINT64_FROM_LE (entry->data_offset),
+                                 GUINT64_FROM_LE (entry->data_size));
+}
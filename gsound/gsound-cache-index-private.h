@@ -0,0 +1,48 @@
+/* gsound-cache-index-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_CACHE_INDEX_PRIVATE_H
+#define GSOUND_CACHE_INDEX_PRIVATE_H
+
+#include "gsound-context.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GSoundCacheIndex GSoundCacheIndex;
+
+GSoundCacheIndex *_gsound_cache_index_new        (void);
+
+void              _gsound_cache_index_free       (GSoundCacheIndex *index);
+
+void              _gsound_cache_index_set_budget (GSoundCacheIndex *index,
+                                                  guint64           budget);
+
+void              _gsound_cache_index_insert     (GSoundCacheIndex *index,
+                                                  const char       *sample_id,
+                                                  guint64           size);
+
+void              _gsound_cache_index_touch      (GSoundCacheIndex *index,
+                                                  const char       *sample_id);
+
+void              _gsound_cache_index_get_stats  (GSoundCacheIndex *index,
+                                                  GSoundCacheStats *stats);
+
+guint64           _gsound_cache_index_get_memory (GSoundCacheIndex *index);
+
+G_END_DECLS
+#endif /* GSOUND_CACHE_INDEX_PRIVATE_H */
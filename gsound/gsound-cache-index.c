@@ -0,0 +1,214 @@
+/* gsound-cache-index.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The client-side record of which samples a context has cached on the
+ * sound server. libcanberra gives us no way to ask the server what it
+ * holds (or to remove anything), so this is all we know.
+ *
+ * Entries are kept in a queue with the most recently used at the head, so
+ * eviction just pops from the tail.
+ */
+
+#include "gsound-cache-index-private.h"
+
+#include <string.h>
+
+typedef struct
+{
+  gchar   *sample_id;
+  guint64  size;
+  gint64   last_used;
+  guint    hits;
+  GList    link;
+} GSoundCacheEntry;
+
+struct _GSoundCacheIndex
+{
+  GMutex      lock;
+  GHashTable *entries;
+  GQueue      lru;
+
+  guint64     budget;
+  guint64     n_bytes;
+
+  guint64     hits;
+  guint64     misses;
+  guint64     evictions;
+};
+
+static void
+gsound_cache_entry_free (gpointer data)
+{
+  GSoundCacheEntry *entry = data;
+
+  g_free (entry->sample_id);
+  g_slice_free (GSoundCacheEntry, entry);
+}
+
+GSoundCacheIndex *
+_gsound_cache_index_new (void)
+{
+  GSoundCacheIndex *index;
+
+  index = g_slice_new0 (GSoundCacheIndex);
+  g_mutex_init (&index->lock);
+  index->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          NULL, gsound_cache_entry_free);
+  g_queue_init (&index->lru);
+
+  return index;
+}
+
+void
+_gsound_cache_index_free (GSoundCacheIndex *index)
+{
+  g_hash_table_unref (index->entries);
+  g_mutex_clear (&index->lock);
+
+  g_slice_free (GSoundCacheIndex, index);
+}
+
+static void
+gsound_cache_index_remove (GSoundCacheIndex *index,
+                           GSoundCacheEntry *entry)
+{
+  g_queue_unlink (&index->lru, &entry->link);
+  index->n_bytes -= entry->size;
+  g_hash_table_remove (index->entries, entry->sample_id);
+}
+
+/* Drops the least recently used entries until we are within budget */
+static void
+gsound_cache_index_enforce_budget (GSoundCacheIndex *index)
+{
+  if (index->budget == 0)
+    return;
+
+  /* Never evict the entry which was just used */
+  while (index->n_bytes > index->budget && index->lru.length > 1)
+    {
+      gsound_cache_index_remove (index, index->lru.tail->data);
+      index->evictions++;
+    }
+}
+
+void
+_gsound_cache_index_set_budget (GSoundCacheIndex *index,
+                                guint64           budget)
+{
+  g_mutex_lock (&index->lock);
+  index->budget = budget;
+  gsound_cache_index_enforce_budget (index);
+  g_mutex_unlock (&index->lock);
+}
+
+void
+_gsound_cache_index_insert (GSoundCacheIndex *index,
+                            const char       *sample_id,
+                            guint64           size)
+{
+  GSoundCacheEntry *entry;
+
+  g_mutex_lock (&index->lock);
+
+  entry = g_hash_table_lookup (index->entries, sample_id);
+  if (entry)
+    {
+      g_queue_unlink (&index->lru, &entry->link);
+      index->n_bytes -= entry->size;
+    }
+  else
+    {
+      entry = g_slice_new0 (GSoundCacheEntry);
+      entry->sample_id = g_strdup (sample_id);
+      entry->link.data = entry;
+      g_hash_table_insert (index->entries, entry->sample_id, entry);
+    }
+
+  entry->size = size;
+  entry->last_used = g_get_monotonic_time ();
+  index->n_bytes += size;
+  g_queue_push_head_link (&index->lru, &entry->link);
+
+  gsound_cache_index_enforce_budget (index);
+
+  g_mutex_unlock (&index->lock);
+}
+
+void
+_gsound_cache_index_touch (GSoundCacheIndex *index,
+                           const char       *sample_id)
+{
+  GSoundCacheEntry *entry;
+
+  g_mutex_lock (&index->lock);
+
+  entry = g_hash_table_lookup (index->entries, sample_id);
+  if (entry)
+    {
+      entry->hits++;
+      entry->last_used = g_get_monotonic_time ();
+      g_queue_unlink (&index->lru, &entry->link);
+      g_queue_push_head_link (&index->lru, &entry->link);
+      index->hits++;
+    }
+  else
+    index->misses++;
+
+  g_mutex_unlock (&index->lock);
+}
+
+void
+_gsound_cache_index_get_stats (GSoundCacheIndex *index,
+                               GSoundCacheStats *stats)
+{
+  g_mutex_lock (&index->lock);
+
+  stats->n_samples = g_hash_table_size (index->entries);
+  stats->n_bytes = index->n_bytes;
+  stats->budget = index->budget;
+  stats->hits = index->hits;
+  stats->misses = index->misses;
+  stats->evictions = index->evictions;
+
+  g_mutex_unlock (&index->lock);
+}
+
+/* Roughly how much memory the index itself uses, not counting the samples */
+guint64
+_gsound_cache_index_get_memory (GSoundCacheIndex *index)
+{
+  GHashTableIter iter;
+  gpointer value;
+  guint64 bytes = sizeof (GSoundCacheIndex);
+
+  g_mutex_lock (&index->lock);
+
+  g_hash_table_iter_init (&iter, index->entries);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      GSoundCacheEntry *entry = value;
+
+      bytes += sizeof (GSoundCacheEntry) + strlen (entry->sample_id) + 1;
+    }
+
+  g_mutex_unlock (&index->lock);
+
+  return bytes;
+}
@@ -0,0 +1,33 @@
+/* gsound-context-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_CONTEXT_PRIVATE_H
+#define GSOUND_CONTEXT_PRIVATE_H
+
+#include "gsound-context.h"
+
+G_BEGIN_DECLS
+
+void              _gsound_context_stop_play        (GSoundContext  *context,
+                                                    guint32         id);
+
+gboolean          _gsound_context_is_play_active   (GSoundContext  *context,
+                                                    guint32         id);
+
+G_END_DECLS
+#endif /* GSOUND_CONTEXT_PRIVATE_H */
@@ -36,6 +36,11 @@
  * g_object_new() (as typically happens with language bindings) then you must
  * call the g_initable_init() method before attempting to use it.
  *
+ * It also implements #GAsyncInitable, so it can be initialized without
+ * blocking using g_async_initable_new_async(). Together with
+ * gsound_context_open_async(), this keeps any contact with the sound server
+ * away from the main thread at application startup.
+ *
  * # Simple Examples
  *
  * In C:
@@ -116,7 +121,12 @@
  * (attribute, value) pairs. When using GObject introspection, attributes are
  * typically passed using a language-specific associated array, for example
  * a dict in Python or an object in JavaScript.
- * 
+ *
+ * If you play the same sound many times, you can instead build a
+ * #GSoundAttributes once and pass it to gsound_context_play_attrs() or
+ * gsound_context_play_attrs_full(). This avoids converting the attributes
+ * on every call.
+ *
  * For the list of attributes supported by GSound, see
  * [GSound Attributes][gsound-GSound-Attributes].
  *
@@ -146,22 +156,135 @@
  * 
  * See the documentation for #GSOUND_ATTR_CANBERRA_CACHE_CONTROL for more
  * details.
+ *
+ * GSound also keeps its own index of the samples it has cached, which can
+ * be given a memory budget with gsound_context_set_cache_budget() and
+ * inspected with gsound_context_get_cache_stats().
+ *
+ * # Threads
+ *
+ * A #GSoundContext may be used from several threads at once without any
+ * extra locking.
+ *
+ * The asynchronous `play_full()` functions never wait for the sound
+ * server: the request is placed on a lock-free queue and handed to
+ * libcanberra from a worker thread owned by the context. The "simple"
+ * play functions, gsound_context_cache() and the attribute setters talk
+ * to the sound server directly, so that they can report errors to the
+ * caller.
  * 
  */
 
-#include "gsound-context.h"
+#include "config.h"
+
+#include "gsound-context-private.h"
+#include "gsound-attr-private.h"
+#include "gsound-attributes-private.h"
+#include "gsound-bank-private.h"
+#include "gsound-cache-index-private.h"
+#include "gsound-null-driver-private.h"
+#include "gsound-playback-private.h"
+#include "gsound-recorder-private.h"
+#include "gsound-result-private.h"
+#include "gsound-sample-file-private.h"
+#include "gsound-theme-cache-private.h"
+#include "gsound-trace-private.h"
 
 #include <canberra.h>
+#include <glib/gstdio.h>
 
 #include <stdarg.h>
+#include <string.h>
 
 static void gsound_context_initable_init (GInitableIface *iface);
+static void gsound_context_async_initable_init (GAsyncInitableIface *iface);
 
 struct _GSoundContext
 {
-  GObject     parent;
+  GObject       parent;
+
+  ca_context   *ca;
+
+  volatile gint next_id;
+
+  GRecMutex     lock;
+  GHashTable   *plays;
+  GHashTable   *cancellables;
+  GMainContext *main_context;
+
+  /* Jobs waiting for the worker thread, newest first */
+  gpointer      queue;
+
+  /* See gsound_context_set_lazy() */
+  volatile gint lazy;
+  volatile gint connection;
+  gchar       **warm_up_events;
+
+  /* What we have cached on the server. See gsound_context_get_cache_stats() */
+  GSoundCacheIndex *cache_index;
+
+  /*
+   * Attributes pushed with gsound_context_push_attributes(), as a GPtrArray
+   * for each thread, innermost last. Protected by the lock.
+   */
+  volatile gint     n_scoped_threads;
+  GHashTable       *scopes;
 
-  ca_context *ca;
+  /*
+   * The values set by each thread with gsound_context_set_attribute_double()
+   * and gsound_context_set_attribute_int(), as a GSoundOverlay. These
+   * threads count towards n_scoped_threads too. Protected by the lock.
+   */
+  GHashTable       *overlays;
+
+  /* See gsound_context_set_theme_cache_enabled() */
+  volatile gint     theme_cache_enabled;
+  GSoundThemeCache *theme_cache;
+
+  /* See gsound_context_set_completion_dispatch(); protected by the lock */
+  GSoundDispatch    dispatch;
+
+  /* Set by gsound_context_set_driver(), before the connection is opened */
+  GSoundNullDriver *null_driver;
+
+  /* See gsound_context_start_recording(); protected by the lock */
+  volatile gint     recording;
+  GSoundRecorder   *recorder;
+
+  /* See gsound_context_set_event_limit(); protected by the lock */
+  volatile gint    limits_enabled;
+  GHashTable      *event_limits;
+  guint            default_interval;
+  guint            default_max_instances;
+  GSoundCoalesceMode default_mode;
+  guint            event_limits_sweep_size;
+
+  /*
+   * Records of finished plays kept for reuse, so that playing a sound
+   * doesn't have to allocate one. Linked through job.next and protected
+   * by the lock.
+   */
+  gpointer          play_pool;
+  guint             n_pooled;
+
+  /* Sounds playing, oldest first. See gsound_context_set_max_voices() */
+  volatile gint    max_voices;
+  GQueue           voices;
+
+  /* For each #GSoundPriority, in msec. See gsound_context_set_deadline() */
+  volatile gint    deadlines_enabled;
+  volatile gint    deadlines[GSOUND_PRIORITY_HIGH + 1];
+
+  /* See gsound_context_set_stats_enabled() */
+  volatile gint    stats_enabled;
+  GMutex           stats_lock;
+  GSoundPlayStats  stats;
+
+  volatile gsize worker_started;
+  GMainContext *worker_context;
+  GMainLoop    *worker_loop;
+  GThread      *worker_thread;
+  GSource      *queue_source;
 };
 
 struct _GSoundContextClass
@@ -171,10 +294,205 @@ struct _GSoundContextClass
 
 G_DEFINE_TYPE_WITH_CODE (GSoundContext, gsound_context, G_TYPE_OBJECT,
                          G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE,
-                                                gsound_context_initable_init))
+                                                gsound_context_initable_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE,
+                                                gsound_context_async_initable_init))
 
 G_DEFINE_QUARK (gsound - error - quark, gsound_error);
 
+typedef struct _CancellableEntry CancellableEntry;
+
+/*
+ * There is one of these for each cancellable which is being used by a
+ * sound on a context. It owns the only signal connection to the
+ * cancellable, and lists the plays which must be stopped when it fires.
+ * The context owns its entries, so they only hold a weak reference back.
+ */
+struct _CancellableEntry
+{
+  volatile gint  ref_count;
+
+  GWeakRef       context;
+  GCancellable  *cancellable;
+  gulong         handler_id;
+  GQueue         plays;
+  gboolean       disconnect_pending;
+
+  /* How many ::cancelled handlers are running; protected by the lock */
+  guint          n_running;
+};
+
+/* The numeric attributes set by one thread, formatted for libcanberra */
+typedef struct
+{
+  guint  n_set;
+  gchar *values[GSOUND_N_ATTR_IDS];
+} GSoundOverlay;
+
+static void
+gsound_overlay_free (gpointer data)
+{
+  GSoundOverlay *overlay = data;
+  guint i;
+
+  for (i = 0; i < GSOUND_N_ATTR_IDS; i++)
+    g_free (overlay->values[i]);
+
+  g_slice_free (GSoundOverlay, overlay);
+}
+
+typedef struct _GSoundJob GSoundJob;
+
+typedef void (*GSoundJobFunc) (GSoundContext *self,
+                               GSoundJob     *job);
+
+/* Something to be done on the worker thread; embedded in larger structs */
+struct _GSoundJob
+{
+  GSoundJob     *next;
+  GSoundJobFunc  run;
+
+  /* A #GSoundPriority, or JOB_PRIORITY_URGENT */
+  guint          priority;
+};
+
+/*
+ * The worker runs jobs in order of priority, and in the order they were
+ * queued within each priority. Jobs which sounds wait for, such as opening
+ * the connection, go before any sound.
+ */
+#define JOB_PRIORITY_URGENT (GSOUND_PRIORITY_HIGH + 1)
+#define N_JOB_PRIORITIES    (JOB_PRIORITY_URGENT + 1)
+
+/*
+ * A job which just completes a task, such as opening the connection. Jobs
+ * queued internally have no task, and hold a reference on the context
+ * instead.
+ */
+typedef struct
+{
+  GSoundJob  job;
+  GTask     *task;
+} GSoundTaskJob;
+
+typedef struct
+{
+  GSoundJob  job;
+  gchar    **events;
+} GSoundWarmUpJob;
+
+enum
+{
+  CONNECTION_NONE,
+  CONNECTION_PENDING,
+  CONNECTION_OPEN
+};
+
+static void gsound_context_open_job (GSoundContext *self,
+                                     GSoundJob     *job);
+
+/*
+ * The rate limit for one event ID, and what it is currently doing. Entries
+ * which were not configured explicitly follow the context's defaults.
+ */
+typedef struct
+{
+  gboolean           configured;
+  guint              min_interval;
+  guint              max_instances;
+  GSoundCoalesceMode mode;
+
+  gint64             last_start;
+  guint              active;
+} GSoundEventLimit;
+
+/* What to do with a sound, according to its event's rate limit */
+typedef enum
+{
+  ADMIT_PLAY,
+  ADMIT_PLAY_LIMITED,   /* Play, and release the instance when finished */
+  ADMIT_MERGE,
+  ADMIT_DROP
+} GSoundAdmission;
+
+/* The attributes of a sound which GSound itself looks at, all borrowed */
+typedef struct
+{
+  const char *event_id;
+  const char *media_role;
+  const char *priority;
+
+  /* What the sound's event ID should be looked up in, if not the defaults */
+  const char *media_filename;
+  const char *theme_name;
+  const char *output_profile;
+  const char *language;
+
+  /* Where the sound's data is, if it was given in memory */
+  GSoundSampleFile *sample;
+
+  /* The handle to tell when the sound finishes, if there is one */
+  GSoundPlayback   *playback;
+} GSoundPlayInfo;
+
+typedef struct _GSoundPlay GSoundPlay;
+
+/* Shared by all the plays started by one gsound_context_play_batch() */
+typedef struct
+{
+  GSoundResult  *task;
+  volatile gint  remaining;
+  GPtrArray     *errors;
+} GSoundBatch;
+
+/*
+ * Book-keeping for a single sound which has been passed to libcanberra.
+ * Every play gets its own ID, so cancelling one never touches another.
+ */
+struct _GSoundPlay
+{
+  GSoundJob         job;
+
+  GSoundContext    *context;
+  guint32           id;
+  GSoundResult     *task;
+  GSoundBatch      *batch;
+  guint             batch_index;
+  CancellableEntry *entry;
+  GList            *link;
+
+  /* Set for queued plays with no task to keep the context alive */
+  gboolean          holds_ref;
+
+  /* The rate-limited event this play counts as an instance of */
+  gchar            *limit_event;
+
+  /* For the null driver to work out how long the sound is */
+  gchar            *media_filename;
+
+  /* Kept open until the sound has finished */
+  GSoundSampleFile *sample;
+  GSoundPlayback   *playback;
+
+  /* Set while the play holds one of the context's voices */
+  GSoundPriority    priority;
+  GList            *voice_link;
+
+  /* Protected by the context lock */
+  gboolean          submitted;
+  gboolean          cancelled;
+
+  /* When we called ca_context_play_full(), if keeping statistics */
+  gint64            submit_time;
+
+  /* When the sound was requested, if there are any deadlines */
+  gint64            request_time;
+
+  /* Only used while waiting in the submission queue */
+  ca_proplist      *proplist;
+  GSoundAttributes *attrs;
+};
+
 static gboolean
 test_return (int code, GError **error)
 {
@@ -185,472 +503,4356 @@ test_return (int code, GError **error)
   return FALSE;
 }
 
-static void
-hash_table_to_prop_list (GHashTable *ht, ca_proplist *pl)
+/*
+ * Adds one attribute to @pl, after checking it. Nothing reaches the sound
+ * server unless every attribute of the sound was acceptable.
+ */
+static gboolean
+prop_list_add (ca_proplist *pl,
+               const char  *key,
+               const char  *value,
+               GError     **error)
+{
+  if (!gsound_attr_validate (key, value, error))
+    return FALSE;
+
+  return test_return (ca_proplist_sets (pl, key, value), error);
+}
+
+/*
+ * These stand in for the ca_context functions of the same names, and go to
+ * the null driver instead if it has been chosen. Like those, they must not
+ * be called with the lock held.
+ */
+static int
+gsound_context_backend_open (GSoundContext *self)
+{
+  if (self->null_driver)
+    return CA_SUCCESS;
+
+  return ca_context_open (self->ca);
+}
+
+static int
+gsound_context_backend_cancel (GSoundContext *self,
+                               guint32        id)
+{
+  if (self->null_driver)
+    return _gsound_null_driver_cancel (self->null_driver, id);
+
+  return ca_context_cancel (self->ca, id);
+}
+
+static int
+gsound_context_backend_cache (GSoundContext *self,
+                              ca_proplist   *pl)
+{
+  if (self->null_driver)
+    return CA_SUCCESS;
+
+  return ca_context_cache_full (self->ca, pl);
+}
+
+static int
+gsound_context_backend_playing (GSoundContext *self,
+                                guint32        id,
+                                int           *playing)
+{
+  if (self->null_driver)
+    return _gsound_null_driver_playing (self->null_driver, id, playing);
+
+  return ca_context_playing (self->ca, id, playing);
+}
+
+static gboolean
+hash_table_to_prop_list (GHashTable  *ht,
+                         ca_proplist *pl,
+                         GError     **error)
 {
   gpointer key, value;
   GHashTableIter iter;
 
-  g_hash_table_ref (ht);
-
   g_hash_table_iter_init (&iter, ht);
   while (g_hash_table_iter_next (&iter, &key, &value))
-    ca_proplist_sets (pl, key, value);
+    {
+      if (!prop_list_add (pl, key, value, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
 
-  g_hash_table_unref (ht);
+/*
+ * The language of a sound is its #GSOUND_ATTR_MEDIA_LANGUAGE, falling back
+ * to #GSOUND_ATTR_APPLICATION_LANGUAGE, whichever order they are given in
+ */
+static void
+gsound_play_info_add (GSoundPlayInfo *info,
+                      const char     *key,
+                      const char     *value)
+{
+  if (g_str_equal (key, GSOUND_ATTR_EVENT_ID))
+    info->event_id = value;
+  else if (g_str_equal (key, GSOUND_ATTR_MEDIA_ROLE))
+    info->media_role = value;
+  else if (g_str_equal (key, GSOUND_ATTR_GSOUND_PRIORITY))
+    info->priority = value;
+  else if (g_str_equal (key, GSOUND_ATTR_MEDIA_FILENAME))
+    info->media_filename = value;
+  else if (g_str_equal (key, GSOUND_ATTR_CANBERRA_XDG_THEME_NAME))
+    info->theme_name = value;
+  else if (g_str_equal (key, GSOUND_ATTR_CANBERRA_XDG_THEME_OUTPUT_PROFILE))
+    info->output_profile = value;
+  else if (g_str_equal (key, GSOUND_ATTR_MEDIA_LANGUAGE))
+    info->language = value;
+  else if (g_str_equal (key, GSOUND_ATTR_APPLICATION_LANGUAGE) &&
+           !info->language)
+    info->language = value;
 }
 
-static int
-var_args_to_prop_list (va_list args, ca_proplist *pl)
+static void
+gsound_play_info_from_hash_table (GSoundPlayInfo *info,
+                                  GHashTable     *ht)
+{
+  info->event_id = g_hash_table_lookup (ht, GSOUND_ATTR_EVENT_ID);
+  info->media_role = g_hash_table_lookup (ht, GSOUND_ATTR_MEDIA_ROLE);
+  info->priority = g_hash_table_lookup (ht, GSOUND_ATTR_GSOUND_PRIORITY);
+  info->media_filename = g_hash_table_lookup (ht, GSOUND_ATTR_MEDIA_FILENAME);
+  info->theme_name = g_hash_table_lookup (ht,
+                                          GSOUND_ATTR_CANBERRA_XDG_THEME_NAME);
+  info->output_profile =
+    g_hash_table_lookup (ht, GSOUND_ATTR_CANBERRA_XDG_THEME_OUTPUT_PROFILE);
+  info->language = g_hash_table_lookup (ht, GSOUND_ATTR_MEDIA_LANGUAGE);
+  if (!info->language)
+    info->language = g_hash_table_lookup (ht,
+                                          GSOUND_ATTR_APPLICATION_LANGUAGE);
+  info->sample = NULL;
+  info->playback = NULL;
+}
+
+static void
+gsound_play_info_from_attrs (GSoundPlayInfo   *info,
+                             GSoundAttributes *attrs)
+{
+  info->event_id = gsound_attributes_lookup_id (attrs,
+                                                GSOUND_ATTR_ID_EVENT_ID);
+  info->media_role = gsound_attributes_lookup_id (attrs,
+                                                  GSOUND_ATTR_ID_MEDIA_ROLE);
+  info->priority = gsound_attributes_lookup_id (attrs,
+                                                GSOUND_ATTR_ID_GSOUND_PRIORITY);
+  info->media_filename =
+    gsound_attributes_lookup_id (attrs, GSOUND_ATTR_ID_MEDIA_FILENAME);
+  info->theme_name =
+    gsound_attributes_lookup_id (attrs, GSOUND_ATTR_ID_CANBERRA_XDG_THEME_NAME);
+  info->output_profile =
+    gsound_attributes_lookup_id (attrs,
+                                 GSOUND_ATTR_ID_CANBERRA_XDG_THEME_OUTPUT_PROFILE);
+  info->language = gsound_attributes_lookup_id (attrs,
+                                                GSOUND_ATTR_ID_MEDIA_LANGUAGE);
+  if (!info->language)
+    info->language =
+      gsound_attributes_lookup_id (attrs, GSOUND_ATTR_ID_APPLICATION_LANGUAGE);
+  info->sample = NULL;
+  info->playback = NULL;
+}
+
+/*
+ * An explicit #GSOUND_ATTR_GSOUND_PRIORITY wins. Otherwise sounds which
+ * matter to the user (calls, accessibility) outrank ordinary events, and
+ * eye candy comes last.
+ */
+static GSoundPriority
+gsound_play_info_get_priority (const GSoundPlayInfo *info)
+{
+  const char *role = info->media_role;
+
+  if (info->priority)
+    {
+      if (g_str_equal (info->priority, "low"))
+        return GSOUND_PRIORITY_LOW;
+      else if (g_str_equal (info->priority, "high"))
+        return GSOUND_PRIORITY_HIGH;
+      else
+        return GSOUND_PRIORITY_NORMAL;
+    }
+
+  if (!role)
+    return GSOUND_PRIORITY_NORMAL;
+
+  if (g_str_equal (role, "phone") || g_str_equal (role, "a11y"))
+    return GSOUND_PRIORITY_HIGH;
+
+  if (g_str_equal (role, "game") || g_str_equal (role, "animation") ||
+      g_str_equal (role, "test"))
+    return GSOUND_PRIORITY_LOW;
+
+  return GSOUND_PRIORITY_NORMAL;
+}
+
+/*
+ * If @info is not %NULL, it is filled in with the attributes GSound
+ * itself needs to know about.
+ */
+static gboolean
+var_args_to_prop_list (va_list         args,
+                       ca_proplist    *pl,
+                       GSoundPlayInfo *info,
+                       GError        **error)
 {
   while (TRUE)
     {
       const char *key;
       const char *val;
-      int res;
 
       key = va_arg (args, const char*);
       if (!key)
-        return CA_SUCCESS;
+        return TRUE;
 
       val = va_arg (args, const char*);
-      if (!val)
-        return CA_ERROR_INVALID;
+      if (!prop_list_add (pl, key, val, error))
+        return FALSE;
 
-      res = ca_proplist_sets (pl, key, val);
-      if (res != CA_SUCCESS)
-        return res;
+      if (info)
+        gsound_play_info_add (info, key, val);
     }
 
-  return CA_SUCCESS;
+  return TRUE;
 }
 
-static void
-on_ca_play_full_finished (ca_context *ca,
-                          guint32     id,
-                          int         error_code,
-                          gpointer    user_data)
+/* Returns the time to use as the start of an interval, or 0 if not needed */
+static gint64
+gsound_context_stats_now (GSoundContext *self)
 {
-  GTask *task = user_data;
+  if (!g_atomic_int_get (&self->stats_enabled))
+    return 0;
 
-  if (error_code != CA_SUCCESS)
-    {
-      g_task_return_new_error (task,
-                               GSOUND_ERROR,
-                               error_code,
-                               "%s",
-                               ca_strerror (error_code));
-    }
-  else
-    g_task_return_boolean (task, TRUE);
+  return g_get_monotonic_time ();
+}
 
-  g_object_unref (task);
+static void
+stats_histogram_add (guint64 *histogram,
+                     gint64   usec)
+{
+  guint bucket = g_bit_storage (MAX (usec, 0)) - 1;
+
+  histogram[MIN (bucket, GSOUND_STATS_N_BUCKETS - 1)]++;
 }
 
+/* Records a submission or completion in the trace, if there is one */
 static void
-on_cancellable_cancelled (GCancellable  *cancellable,
-                          GSoundContext *self)
+gsound_context_trace_event (GSoundContext *self,
+                            const char    *event,
+                            guint32        id,
+                            int            code)
 {
-  ca_context_cancel (self->ca, g_direct_hash (cancellable));
+  if (G_LIKELY (!g_atomic_int_get (&self->recording)))
+    return;
+
+  g_rec_mutex_lock (&self->lock);
+  if (self->recorder)
+    _gsound_recorder_add_event (self->recorder, event, id, code);
+  g_rec_mutex_unlock (&self->lock);
 }
 
-/**
- * gsound_context_new:
- * @cancellable: (allow-none): A #GCancellable, or %NULL
- * @error: Return location for error
- *
- * Creates and initializes a new #GSoundContext. If the an error occured
- * during initialization, #NULL is returned and @error will be set
- * appropriately.
- *
- * Returns: (transfer full): A new #GSoundContext
- */
-GSoundContext *
-gsound_context_new (GCancellable *cancellable, GError **error)
+/* Records the outcome of ca_context_play_full(), which began at @start */
+static void
+gsound_context_record_submit (GSoundContext *self,
+                              guint32        id,
+                              gint64         start,
+                              int            res)
 {
-  return GSOUND_CONTEXT (g_initable_new (GSOUND_TYPE_CONTEXT,
-                                         cancellable,
-                                         error,
-                                         NULL));
+  gint64 usec = 0;
+
+  if (start)
+    {
+      usec = g_get_monotonic_time () - start;
+
+      g_mutex_lock (&self->stats_lock);
+      stats_histogram_add (self->stats.submit_latency, usec);
+      if (res == CA_SUCCESS)
+        self->stats.n_submitted++;
+      g_mutex_unlock (&self->stats_lock);
+    }
+
+  GSOUND_TRACE3 (play__submit, id, res, usec);
+  gsound_context_trace_event (self, "submit", id, res);
 }
 
-/**
- * gsound_context_open:
- * @context: A #GSoundContext
- * @error: Return location for error
- *
- * Attempts to open a connection to the backend sound driver. It is recommended
- * that you set context attributes with gsound_context_set_attributes() before
- * calling this function.
- *
- * > A connection is automatically opened before playing or caching sounds,
- * > so you rarely need to call this yourself.
- *
- * Returns: %TRUE if the output device was opened successfully, or %FALSE
- *          (populating @error)
+/*
+ * Records how a sound ended. @start is when it was submitted, or 0 if it
+ * never was (or we weren't keeping statistics at the time).
  */
-gboolean
-gsound_context_open (GSoundContext *self, GError **error)
+static void
+gsound_context_record_result (GSoundContext *self,
+                              guint32        id,
+                              gint64         start,
+                              int            res)
 {
-  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+  gint64 usec = 0;
 
-  return test_return (ca_context_open (self->ca), error);
+  if (start)
+    usec = g_get_monotonic_time () - start;
+
+  GSOUND_TRACE3 (play__complete, id, res, usec);
+  gsound_context_trace_event (self, "finish", id, res);
+
+  if (!g_atomic_int_get (&self->stats_enabled))
+    return;
+
+  g_mutex_lock (&self->stats_lock);
+  if (res == CA_SUCCESS)
+    {
+      self->stats.n_completed++;
+      if (start)
+        stats_histogram_add (self->stats.completion_latency, usec);
+    }
+  else if (res == CA_ERROR_CANCELED)
+    self->stats.n_cancelled++;
+  else if (-res > 0 && -res < GSOUND_STATS_N_ERRORS)
+    self->stats.n_errors[-res]++;
+  g_mutex_unlock (&self->stats_lock);
 }
 
-/**
- * gsound_context_set_driver:
- * @context: A #GSoundContext
- * @driver: libcanberra driver to use
- * @error: Return location for error, or %NULL
- *
- * Sets the libcanberra driver to @driver, for example "pulse", "alsa" or "null".
- * You normally do not need to set this yourself.
- *
- * Note that this function may return %TRUE even if the specified driver is
- * not available: see the libcanberra documentation for details.
- *
- * Returns: %TRUE if the libcanberra driver was set successfully
+/*
+ * Whether an entry only remembers the defaults being applied to an event
+ * which is no longer limited by them, and so can be forgotten
  */
-gboolean
-gsound_context_set_driver (GSoundContext *self,
-                           const char    *driver,
-                           GError       **error)
+static gboolean
+gsound_event_limit_is_stale (GSoundEventLimit *limit,
+                             gint64            now)
 {
-  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+  return !limit->configured && limit->active == 0 &&
+         now - limit->last_start >= limit->min_interval * (gint64) 1000;
+}
 
-  return test_return (ca_context_set_driver (self->ca, driver), error);
+static gboolean
+remove_stale_event_limit (gpointer key,
+                          gpointer value,
+                          gpointer user_data)
+{
+  return gsound_event_limit_is_stale (value, *(gint64 *) user_data);
 }
 
-/**
- * gsound_context_set_attributes: (skip)
- * @context: A #GSoundContext
- * @error: Return location for error
- * @...: %NULL terminated list of attribute name-value pairs
- *
- * Set attributes or change attributes on @context. Subsequent calls to this
- * function calling the same attributes will override the earlier values.
- *
- * Note that GSound will set the #GSOUND_ATTR_APPLICATION_NAME and
- * #GSOUND_ATTR_APPLICATION_ID for you if using #GApplication, so you do
- * not normally need to set these yourself.
- *
- * Returns: %TRUE if attributes were updated successfully
+/*
+ * Decides whether a sound for @event_id may be played now. If the result
+ * is ADMIT_PLAY_LIMITED, the sound counts towards the event's instance
+ * limit until gsound_context_release_event() is called.
  */
-gboolean
-gsound_context_set_attributes (GSoundContext *self,
-                               GError       **error,
-                               ...)
+static GSoundAdmission
+gsound_context_admit (GSoundContext *self,
+                      const char    *event_id)
 {
-  ca_proplist *pl;
-  va_list args;
-  int res;
+  GSoundAdmission admission = ADMIT_PLAY_LIMITED;
+  GSoundEventLimit *limit;
+  gint64 now;
 
+  if (!event_id || !g_atomic_int_get (&self->limits_enabled))
+    return ADMIT_PLAY;
+
+  g_rec_mutex_lock (&self->lock);
+
+  limit = g_hash_table_lookup (self->event_limits, event_id);
+  if (!limit)
+    {
+      if (self->default_interval == 0 && self->default_max_instances == 0)
+        {
+          g_rec_mutex_unlock (&self->lock);
+          return ADMIT_PLAY;
+        }
+
+      /*
+       * Applications can use any number of event IDs, so forget the ones
+       * which aren't playing whenever the table has doubled in size.
+       * Most are removed as they are released anyway.
+       */
+      if (g_hash_table_size (self->event_limits) >=
+          self->event_limits_sweep_size)
+        {
+          now = g_get_monotonic_time ();
+          g_hash_table_foreach_remove (self->event_limits,
+                                       remove_stale_event_limit, &now);
+          self->event_limits_sweep_size =
+            MAX (64, 2 * g_hash_table_size (self->event_limits));
+        }
+
+      limit = g_slice_new0 (GSoundEventLimit);
+      g_hash_table_insert (self->event_limits, g_strdup (event_id), limit);
+    }
+
+  if (!limit->configured)
+    {
+      limit->min_interval = self->default_interval;
+      limit->max_instances = self->default_max_instances;
+      limit->mode = self->default_mode;
+    }
+
+  now = g_get_monotonic_time ();
+
+  if (limit->min_interval == 0 && limit->max_instances == 0)
+    admission = ADMIT_PLAY;
+  else if ((limit->last_start &&
+            now - limit->last_start < limit->min_interval * (gint64) 1000) ||
+           (limit->max_instances && limit->active >= limit->max_instances))
+    admission = limit->mode == GSOUND_COALESCE_MERGE ? ADMIT_MERGE : ADMIT_DROP;
+  else
+    {
+      limit->last_start = now;
+      limit->active++;
+    }
+
+  g_rec_mutex_unlock (&self->lock);
+
+  return admission;
+}
+
+static void
+gsound_context_release_event (GSoundContext *self,
+                              const char    *event_id)
+{
+  GSoundEventLimit *limit;
+
+  g_rec_mutex_lock (&self->lock);
+  limit = g_hash_table_lookup (self->event_limits, event_id);
+  if (limit && limit->active > 0)
+    limit->active--;
+  if (limit && gsound_event_limit_is_stale (limit, g_get_monotonic_time ()))
+    g_hash_table_remove (self->event_limits, event_id);
+  g_rec_mutex_unlock (&self->lock);
+}
+
+/*
+ * Returns the error to report for a sound which was not admitted, or
+ * %NULL if it was merged with one which is already playing.
+ */
+static GError *
+gsound_admission_error (GSoundAdmission admission,
+                        const char     *event_id)
+{
+  if (admission == ADMIT_MERGE)
+    return NULL;
+
+  return g_error_new (G_IO_ERROR, G_IO_ERROR_BUSY,
+                      "Sound \"%s\" was dropped by its rate limit", event_id);
+}
+
+/*
+ * Like var_args_to_prop_list(), but for a list of (#GSoundAttrId, value)
+ * pairs ended by GSOUND_ATTR_ID_INVALID.
+ */
+static gboolean
+var_args_ids_to_prop_list (va_list         args,
+                           ca_proplist    *pl,
+                           GSoundPlayInfo *info,
+                           GError        **error)
+{
+  while (TRUE)
+    {
+      GSoundAttrId id;
+      const char *key;
+      const char *val;
+
+      id = va_arg (args, GSoundAttrId);
+      if (id == GSOUND_ATTR_ID_INVALID)
+        return TRUE;
+
+      key = gsound_attr_id_to_key (id);
+      if (!key)
+        {
+          g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                       "Invalid attribute ID %d", id);
+          return FALSE;
+        }
+
+      val = va_arg (args, const char*);
+      if (!prop_list_add (pl, key, val, error))
+        return FALSE;
+
+      switch (id)
+        {
+        case GSOUND_ATTR_ID_EVENT_ID:
+          info->event_id = val;
+          break;
+        case GSOUND_ATTR_ID_MEDIA_ROLE:
+          info->media_role = val;
+          break;
+        case GSOUND_ATTR_ID_GSOUND_PRIORITY:
+          info->priority = val;
+          break;
+        case GSOUND_ATTR_ID_MEDIA_FILENAME:
+          info->media_filename = val;
+          break;
+        case GSOUND_ATTR_ID_CANBERRA_XDG_THEME_NAME:
+          info->theme_name = val;
+          break;
+        case GSOUND_ATTR_ID_CANBERRA_XDG_THEME_OUTPUT_PROFILE:
+          info->output_profile = val;
+          break;
+        case GSOUND_ATTR_ID_MEDIA_LANGUAGE:
+          info->language = val;
+          break;
+        case GSOUND_ATTR_ID_APPLICATION_LANGUAGE:
+          if (!info->language)
+            info->language = val;
+          break;
+        default:
+          break;
+        }
+    }
+
+  return TRUE;
+}
+
+static CancellableEntry *
+cancellable_entry_ref (CancellableEntry *entry)
+{
+  g_atomic_int_inc (&entry->ref_count);
+  return entry;
+}
+
+static void
+cancellable_entry_unref (CancellableEntry *entry)
+{
+  if (!g_atomic_int_dec_and_test (&entry->ref_count))
+    return;
+
+  g_object_unref (entry->cancellable);
+  g_weak_ref_clear (&entry->context);
+
+  g_slice_free (CancellableEntry, entry);
+}
+
+static void
+on_cancellable_cancelled (GCancellable     *cancellable,
+                          CancellableEntry *entry)
+{
+  GSoundContext *self = g_weak_ref_get (&entry->context);
+  GArray *ids;
+  GList *l;
+  guint i;
+
+  if (!self)
+    return;
+
+  ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  g_rec_mutex_lock (&self->lock);
+  entry->n_running++;
+  for (l = entry->plays.head; l; l = l->next)
+    {
+      GSoundPlay *play = l->data;
+
+      /* Plays still in the queue will notice this before submission */
+      play->cancelled = TRUE;
+      if (play->submitted)
+        g_array_append_val (ids, play->id);
+    }
+  g_rec_mutex_unlock (&self->lock);
+
+  /* libcanberra must not be called with the lock held */
+  for (i = 0; i < ids->len; i++)
+    gsound_context_backend_cancel (self, g_array_index (ids, guint32, i));
+
+  g_array_free (ids, TRUE);
+
+  g_rec_mutex_lock (&self->lock);
+  entry->n_running--;
+  g_rec_mutex_unlock (&self->lock);
+
+  g_object_unref (self);
+}
+
+static gboolean
+disconnect_idle_entry (gpointer user_data)
+{
+  CancellableEntry *entry = user_data;
+  GSoundContext *self = g_weak_ref_get (&entry->context);
+  gboolean idle;
+
+  /* If the context has gone, it disconnected all of its entries */
+  if (!self)
+    return G_SOURCE_REMOVE;
+
+  g_rec_mutex_lock (&self->lock);
+
+  entry->disconnect_pending = FALSE;
+
+  /* A new play may have started using the cancellable in the meantime */
+  idle = g_queue_is_empty (&entry->plays);
+  if (idle)
+    g_hash_table_remove (self->cancellables, entry->cancellable);
+
+  g_rec_mutex_unlock (&self->lock);
+
+  /* Not under the lock: this waits for handlers running in other threads */
+  if (idle)
+    g_cancellable_disconnect (entry->cancellable, entry->handler_id);
+
+  g_object_unref (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static guint32
+gsound_context_next_id (GSoundContext *self)
+{
+  guint32 id;
+
+  /* Zero is never handed out, so it can be used to mean "no sound" */
+  do
+    id = (guint32) g_atomic_int_add (&self->next_id, 1);
+  while (G_UNLIKELY (id == 0));
+
+  return id;
+}
+
+/* The most finished play records a context keeps for reuse */
+#define PLAY_POOL_SIZE 32
+
+/* Takes a cleared play record from the pool. Must be called with the lock held */
+static GSoundPlay *
+gsound_context_alloc_play (GSoundContext *self)
+{
+  GSoundPlay *play;
+
+  if (!self->play_pool)
+    return g_slice_new0 (GSoundPlay);
+
+  play = self->play_pool;
+  self->play_pool = play->job.next;
+  self->n_pooled--;
+
+  memset (play, 0, sizeof (GSoundPlay));
+
+  return play;
+}
+
+/* Gives the record of a finished play back to the pool, if there is room */
+static void
+gsound_context_release_play (GSoundContext *self,
+                             GSoundPlay    *play)
+{
+  g_rec_mutex_lock (&self->lock);
+
+  if (self->n_pooled < PLAY_POOL_SIZE)
+    {
+      play->job.next = self->play_pool;
+      self->play_pool = play;
+      self->n_pooled++;
+      play = NULL;
+    }
+
+  g_rec_mutex_unlock (&self->lock);
+
+  if (play)
+    g_slice_free (GSoundPlay, play);
+}
+
+/* Creates the result of a sound, to be completed wherever the context says */
+static GSoundResult *
+gsound_context_new_result (GSoundContext      *self,
+                           GCancellable       *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer            user_data)
+{
+  GSoundResult *result;
+
+  g_rec_mutex_lock (&self->lock);
+  result = _gsound_result_new (self, cancellable, callback, user_data,
+                               &self->dispatch);
+  g_rec_mutex_unlock (&self->lock);
+
+  return result;
+}
+
+static GSoundPlay *
+gsound_play_new (GSoundContext *self,
+                 GCancellable  *cancellable,
+                 GSoundResult  *task)
+{
+  CancellableEntry *entry;
+  GSoundPlay *play;
+
+  g_rec_mutex_lock (&self->lock);
+
+  play = gsound_context_alloc_play (self);
+  play->context = self;
+  play->id = gsound_context_next_id (self);
+  play->task = task;
+
+  g_hash_table_insert (self->plays, GUINT_TO_POINTER (play->id), play);
+
+  if (!cancellable)
+    {
+      g_rec_mutex_unlock (&self->lock);
+      return play;
+    }
+
+  entry = g_hash_table_lookup (self->cancellables, cancellable);
+  if (!entry)
+    {
+      entry = g_slice_new0 (CancellableEntry);
+      entry->ref_count = 1;
+      g_weak_ref_init (&entry->context, self);
+      entry->cancellable = g_object_ref (cancellable);
+      g_queue_init (&entry->plays);
+
+      g_hash_table_insert (self->cancellables, cancellable, entry);
+
+      entry->handler_id =
+        g_cancellable_connect (cancellable,
+                               G_CALLBACK (on_cancellable_cancelled),
+                               cancellable_entry_ref (entry),
+                               (GDestroyNotify) cancellable_entry_unref);
+    }
+
+  g_queue_push_tail (&entry->plays, play);
+  play->link = entry->plays.tail;
+  play->entry = cancellable_entry_ref (entry);
+
+  g_rec_mutex_unlock (&self->lock);
+
+  return play;
+}
+
+static void
+gsound_play_free (GSoundPlay *play)
+{
+  CancellableEntry *entry = play->entry;
+  GSoundContext *self = play->context;
+  gboolean disconnect = FALSE;
+
+  g_rec_mutex_lock (&self->lock);
+
+  g_hash_table_remove (self->plays, GUINT_TO_POINTER (play->id));
+
+  if (play->voice_link)
+    g_queue_delete_link (&self->voices, play->voice_link);
+
+  if (entry)
+    {
+      g_queue_delete_link (&entry->plays, play->link);
+
+      /*
+       * Disconnecting waits for any handler which is running, and that
+       * may be waiting for libcanberra, which may be what is calling us.
+       * In that case, disconnect from an idle handler instead.
+       */
+      if (g_queue_is_empty (&entry->plays) && !entry->disconnect_pending &&
+          entry->n_running == 0)
+        {
+          /* New plays with the same cancellable will get a new entry */
+          g_hash_table_steal (self->cancellables, entry->cancellable);
+          disconnect = TRUE;
+        }
+      else if (g_queue_is_empty (&entry->plays) && !entry->disconnect_pending)
+        {
+          GSource *source;
+
+          entry->disconnect_pending = TRUE;
+
+          source = g_idle_source_new ();
+          g_source_set_callback (source,
+                                 disconnect_idle_entry,
+                                 cancellable_entry_ref (entry),
+                                 (GDestroyNotify) cancellable_entry_unref);
+          g_source_attach (source, self->main_context);
+          g_source_unref (source);
+        }
+    }
+
+  g_rec_mutex_unlock (&self->lock);
+
+  if (disconnect)
+    {
+      g_cancellable_disconnect (entry->cancellable, entry->handler_id);
+      cancellable_entry_unref (entry);
+    }
+
+  if (play->limit_event)
+    {
+      gsound_context_release_event (self, play->limit_event);
+      g_free (play->limit_event);
+    }
+
+  g_clear_pointer (&play->proplist, ca_proplist_destroy);
+  g_clear_pointer (&play->attrs, gsound_attributes_unref);
+  g_clear_pointer (&play->sample, _gsound_sample_file_unref);
+  g_clear_object (&play->playback);
+  g_free (play->media_filename);
+
+  gsound_context_release_play (self, play);
+
+  /* The entry only holds a weak reference on the context */
+  if (entry)
+    cancellable_entry_unref (entry);
+}
+
+static void
+clear_error_func (gpointer data)
+{
+  if (data)
+    g_error_free (data);
+}
+
+/* Takes ownership of @error, which is %NULL if the item succeeded */
+static void
+gsound_batch_item_complete (GSoundBatch *batch,
+                            guint        index,
+                            GError      *error)
+{
+  /* Each item has its own slot, so this needs no locking */
+  g_ptr_array_index (batch->errors, index) = error;
+
+  if (!g_atomic_int_dec_and_test (&batch->remaining))
+    return;
+
+  _gsound_result_return_pointer (batch->task,
+                                 g_ptr_array_ref (batch->errors),
+                                 (GDestroyNotify) g_ptr_array_unref);
+
+  g_object_unref (batch->task);
+  g_ptr_array_unref (batch->errors);
+  g_slice_free (GSoundBatch, batch);
+}
+
+static void
+gsound_play_complete (GSoundPlay *play,
+                      int         error_code)
+{
+  GSoundBatch *batch = play->batch;
+  guint batch_index = play->batch_index;
+  GSoundResult *task = play->task;
+
+  gsound_context_record_result (play->context, play->id,
+                                play->submit_time, error_code);
+
+  if (play->playback)
+    _gsound_playback_finish (play->playback, error_code);
+
+  gsound_play_free (play);
+
+  if (batch)
+    {
+      GError *error = NULL;
+
+      if (error_code != CA_SUCCESS)
+        error = g_error_new_literal (GSOUND_ERROR, error_code,
+                                     ca_strerror (error_code));
+
+      gsound_batch_item_complete (batch, batch_index, error);
+    }
+
+  if (!task)
+    return;
+
+  if (error_code != CA_SUCCESS)
+    {
+      _gsound_result_return_error (task,
+                                   g_error_new_literal (GSOUND_ERROR,
+                                                        error_code,
+                                                        ca_strerror (error_code)));
+    }
+  else
+    _gsound_result_return_boolean (task, TRUE);
+
+  g_object_unref (task);
+}
+
+static void
+on_ca_play_full_finished (ca_context *ca,
+                          guint32     id,
+                          int         error_code,
+                          gpointer    user_data)
+{
+  gsound_play_complete (user_data, error_code);
+}
+
+static void
+on_null_driver_finished (guint32  id,
+                         int      error_code,
+                         gpointer user_data)
+{
+  gsound_play_complete (user_data, error_code);
+}
+
+/* Like ca_context_play_full(); @play is %NULL if nobody needs to know */
+static int
+gsound_context_backend_play (GSoundContext *self,
+                             guint32        id,
+                             ca_proplist   *pl,
+                             const char    *filename,
+                             GSoundPlay    *play)
+{
+  if (self->null_driver)
+    return _gsound_null_driver_play (self->null_driver, id, filename,
+                                     play ? on_null_driver_finished : NULL,
+                                     play);
+
+  return ca_context_play_full (self->ca, id, pl,
+                               play ? on_ca_play_full_finished : NULL, play);
+}
+
+/*
+ * Moves everything in the worker's queue onto the end of the lists in
+ * @heads and @tails, one for each job priority
+ */
+static void
+gsound_context_take_queue (GSoundContext *self,
+                           GSoundJob    **heads,
+                           GSoundJob    **tails)
+{
+  GSoundJob *batch, *job;
+  GSoundJob *pending = NULL;
+
+  /* Take everything at once, so producers never wait for us */
+  do
+    batch = g_atomic_pointer_get (&self->queue);
+  while (!g_atomic_pointer_compare_and_exchange (&self->queue, batch, NULL));
+
+  /* The queue is newest-first, so put it back in submission order */
+  while (batch)
+    {
+      job = batch;
+      batch = job->next;
+      job->next = pending;
+      pending = job;
+    }
+
+  while (pending)
+    {
+      job = pending;
+      pending = job->next;
+      job->next = NULL;
+
+      if (tails[job->priority])
+        tails[job->priority]->next = job;
+      else
+        heads[job->priority] = job;
+      tails[job->priority] = job;
+    }
+}
+
+static gboolean
+gsound_context_drain_queue (gpointer user_data)
+{
+  GSoundContext *self = user_data;
+  GSoundJob *heads[N_JOB_PRIORITIES] = { NULL, };
+  GSoundJob *tails[N_JOB_PRIORITIES] = { NULL, };
+  GSoundJob *job;
+  gint i;
+
+  g_source_set_ready_time (self->queue_source, -1);
+
+  gsound_context_take_queue (self, heads, tails);
+
+  while (TRUE)
+    {
+      for (i = N_JOB_PRIORITIES - 1; i >= 0 && !heads[i]; i--)
+        ;
+
+      if (i < 0)
+        break;
+
+      job = heads[i];
+      heads[i] = job->next;
+      if (!heads[i])
+        tails[i] = NULL;
+      job->next = NULL;
+
+      /* The last job may drop the last reference on us */
+      job->run (self, job);
+
+      for (i = 0; i < N_JOB_PRIORITIES && !heads[i]; i++)
+        ;
+
+      /*
+       * Every job still waiting keeps us alive. Let anything important
+       * which arrived in the meantime jump ahead of them.
+       */
+      if (i < N_JOB_PRIORITIES)
+        gsound_context_take_queue (self, heads, tails);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+queue_source_dispatch (GSource    *source,
+                       GSourceFunc callback,
+                       gpointer    user_data)
+{
+  return callback (user_data);
+}
+
+static GSourceFuncs queue_source_funcs = {
+  NULL, NULL, queue_source_dispatch, NULL, NULL, NULL
+};
+
+static gpointer
+gsound_context_worker (gpointer user_data)
+{
+  GSoundContext *self = user_data;
+  GMainContext *context = g_main_context_ref (self->worker_context);
+  GMainLoop *loop = g_main_loop_ref (self->worker_loop);
+
+  /* The context may be finalized from one of our own jobs */
+  g_main_context_push_thread_default (context);
+  g_main_loop_run (loop);
+  g_main_context_pop_thread_default (context);
+
+  g_main_loop_unref (loop);
+  g_main_context_unref (context);
+
+  return NULL;
+}
+
+static void
+gsound_context_ensure_worker (GSoundContext *self)
+{
+  if (g_once_init_enter (&self->worker_started))
+    {
+      self->worker_context = g_main_context_new ();
+      self->worker_loop = g_main_loop_new (self->worker_context, FALSE);
+
+      self->queue_source = g_source_new (&queue_source_funcs, sizeof (GSource));
+      g_source_set_name (self->queue_source, "GSoundContext submission queue");
+      g_source_set_callback (self->queue_source,
+                             gsound_context_drain_queue, self, NULL);
+      g_source_attach (self->queue_source, self->worker_context);
+
+      self->worker_thread = g_thread_new ("gsound-worker",
+                                          gsound_context_worker,
+                                          self);
+
+      g_once_init_leave (&self->worker_started, 1);
+    }
+}
+
+/*
+ * Pushes a chain of jobs, linked newest-first from @newest through to
+ * @oldest, onto the worker's queue in a single step.
+ */
+static void
+gsound_context_push_jobs (GSoundContext *self,
+                          GSoundJob     *newest,
+                          GSoundJob     *oldest)
+{
+  GSoundJob *head;
+
+  gsound_context_ensure_worker (self);
+
+  do
+    {
+      head = g_atomic_pointer_get (&self->queue);
+      oldest->next = head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange (&self->queue, head, newest));
+
+  /* Only the push which makes the queue non-empty needs to wake the worker */
+  if (!head)
+    g_source_set_ready_time (self->queue_source, 0);
+}
+
+/* Runs @run with a #GSoundTaskJob for @task on the worker thread */
+static void
+gsound_context_queue_task (GSoundContext *self,
+                           GTask         *task,
+                           GSoundJobFunc  run)
+{
+  GSoundTaskJob *job;
+
+  job = g_slice_new0 (GSoundTaskJob);
+  job->job.run = run;
+  job->job.priority = JOB_PRIORITY_URGENT;
+  job->task = task;
+
+  if (!task)
+    g_object_ref (self);
+
+  gsound_context_push_jobs (self, &job->job, &job->job);
+}
+
+static void
+gsound_context_warm_up_job (GSoundContext *self,
+                            GSoundJob     *job)
+{
+  GSoundWarmUpJob *warm_up = (GSoundWarmUpJob *) job;
+  guint i;
+
+  for (i = 0; warm_up->events[i]; i++)
+    {
+      ca_proplist *pl;
+      int res;
+
+      if (ca_proplist_create (&pl) != CA_SUCCESS)
+        break;
+
+      ca_proplist_sets (pl, CA_PROP_EVENT_ID, warm_up->events[i]);
+      res = gsound_context_backend_cache (self, pl);
+      ca_proplist_destroy (pl);
+
+      if (res != CA_SUCCESS)
+        g_debug ("Failed to cache warm-up sound \"%s\": %s",
+                 warm_up->events[i], ca_strerror (res));
+    }
+
+  g_strfreev (warm_up->events);
+  g_slice_free (GSoundWarmUpJob, warm_up);
+
+  g_object_unref (self);
+}
+
+static void
+gsound_context_schedule_warm_up (GSoundContext *self)
+{
+  GSoundWarmUpJob *job;
+  gchar **events;
+
+  g_rec_mutex_lock (&self->lock);
+  events = self->warm_up_events;
+  self->warm_up_events = NULL;
+  g_rec_mutex_unlock (&self->lock);
+
+  if (!events)
+    return;
+
+  job = g_slice_new0 (GSoundWarmUpJob);
+  job->job.run = gsound_context_warm_up_job;
+  job->job.priority = GSOUND_PRIORITY_LOW;
+  job->events = events;
+  g_object_ref (self);
+
+  gsound_context_push_jobs (self, &job->job, &job->job);
+}
+
+/* Called whenever something shows that we are talking to the server */
+static void
+gsound_context_set_connected (GSoundContext *self)
+{
+  if (G_LIKELY (g_atomic_int_get (&self->connection) == CONNECTION_OPEN))
+    return;
+
+  g_atomic_int_set (&self->connection, CONNECTION_OPEN);
+  gsound_context_schedule_warm_up (self);
+}
+
+/*
+ * In lazy mode, the first sound starts connecting from the worker thread.
+ * Returns %TRUE while that connection is still being made, in which case
+ * sounds should be queued behind it.
+ */
+static gboolean
+gsound_context_ensure_connection (GSoundContext *self)
+{
+  if (!g_atomic_int_get (&self->lazy))
+    return FALSE;
+
+  if (g_atomic_int_compare_and_exchange (&self->connection,
+                                         CONNECTION_NONE,
+                                         CONNECTION_PENDING))
+    gsound_context_queue_task (self, NULL, gsound_context_open_job);
+
+  return g_atomic_int_get (&self->connection) == CONNECTION_PENDING;
+}
+
+/*
+ * Reserves a voice for @play, stealing voices until there is one free. Each
+ * victim is the lowest priority voice, or the oldest among equals, as long
+ * as it doesn't outrank @play; after the limit is lowered, this reclaims
+ * the excess voices too. Returns %FALSE if there was nothing (more) to
+ * steal. Must not be called with the lock held.
+ */
+static gboolean
+gsound_context_claim_voice (GSoundContext *self,
+                            GSoundPlay    *play)
+{
+  guint max_voices = g_atomic_int_get (&self->max_voices);
+  GArray *victim_ids = NULL;
+  gboolean claimed = TRUE;
+  GList *l;
+  guint i;
+
+  if (max_voices == 0)
+    return TRUE;
+
+  g_rec_mutex_lock (&self->lock);
+
+  while (self->voices.length >= max_voices)
+    {
+      GSoundPlay *victim = NULL;
+
+      for (l = self->voices.head; l; l = l->next)
+        {
+          GSoundPlay *voice = l->data;
+
+          if (voice->priority <= play->priority &&
+              (!victim || voice->priority < victim->priority))
+            victim = voice;
+        }
+
+      if (!victim)
+        {
+          claimed = FALSE;
+          break;
+        }
+
+      g_queue_delete_link (&self->voices, victim->voice_link);
+      victim->voice_link = NULL;
+
+      /* If it is still being submitted, that will cancel it for us */
+      victim->cancelled = TRUE;
+      if (victim->submitted)
+        {
+          if (!victim_ids)
+            victim_ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+          g_array_append_val (victim_ids, victim->id);
+        }
+    }
+
+  if (claimed)
+    {
+      g_queue_push_tail (&self->voices, play);
+      play->voice_link = self->voices.tail;
+    }
+
+  g_rec_mutex_unlock (&self->lock);
+
+  /* libcanberra must not be called with the lock held */
+  for (i = 0; victim_ids && i < victim_ids->len; i++)
+    gsound_context_backend_cancel (self,
+                                   g_array_index (victim_ids, guint32, i));
+
+  if (victim_ids)
+    g_array_free (victim_ids, TRUE);
+
+  return claimed;
+}
+
+/*
+ * Hands @play to libcanberra, unless it was cancelled while waiting. If
+ * this fails then @play is left untouched and will not be completed by
+ * libcanberra. Must not be called with the lock held.
+ */
+static int
+gsound_context_start_play (GSoundContext *self,
+                           GSoundPlay    *play,
+                           ca_proplist   *pl)
+{
+  guint32 id = play->id;
+  gint64 submit_time;
+  gboolean cancelled;
+  int res;
+
+  g_rec_mutex_lock (&self->lock);
+  cancelled = play->cancelled;
+  g_rec_mutex_unlock (&self->lock);
+
+  if (cancelled)
+    return CA_ERROR_CANCELED;
+
+  /* A sound which can't get a voice is treated as stolen straight away */
+  if (!gsound_context_claim_voice (self, play))
+    return CA_ERROR_CANCELED;
+
+  /*
+   * Nothing can complete the play until libcanberra has it, but once it
+   * does, the play may be completed and freed before the call returns
+   */
+  submit_time = gsound_context_stats_now (self);
+  play->submit_time = submit_time;
+
+  res = gsound_context_backend_play (self, id, pl,
+                                     play->sample ?
+                                     _gsound_sample_file_get_path (play->sample) :
+                                     play->media_filename,
+                                     play);
+  gsound_context_record_submit (self, id, submit_time, res);
+  if (res != CA_SUCCESS)
+    {
+      /* A play which failed to submit is never completed, so it is ours */
+      play->submit_time = 0;
+      return res;
+    }
+
+  gsound_context_set_connected (self);
+
+  /*
+   * The sound may have finished already, so we can only get at the play
+   * through the index. If it was cancelled while we were submitting it,
+   * the handler couldn't stop it, so we must.
+   */
+  cancelled = FALSE;
+
+  g_rec_mutex_lock (&self->lock);
+  play = g_hash_table_lookup (self->plays, GUINT_TO_POINTER (id));
+  if (play)
+    {
+      play->submitted = TRUE;
+      cancelled = play->cancelled;
+    }
+  g_rec_mutex_unlock (&self->lock);
+
+  if (cancelled)
+    gsound_context_backend_cancel (self, id);
+
+  return CA_SUCCESS;
+}
+
+/* Whether @play has waited too long to be worth playing */
+static gboolean
+gsound_play_is_late (GSoundContext *self,
+                     GSoundPlay    *play)
+{
+  gint64 deadline;
+
+  if (G_LIKELY (!play->request_time))
+    return FALSE;
+
+  deadline = g_atomic_int_get (&self->deadlines[play->priority]);
+
+  return deadline &&
+         g_get_monotonic_time () - play->request_time > deadline * 1000;
+}
+
+static void
+gsound_play_run (GSoundContext *self,
+                 GSoundJob     *job)
+{
+  GSoundPlay *play = (GSoundPlay *) job;
+  gboolean holds_ref = play->holds_ref;
+  ca_proplist *pl;
+  int res;
+
+  pl = play->attrs ? _gsound_attributes_get_proplist (play->attrs)
+                   : play->proplist;
+
+  /* A late sound is dropped exactly as if it had been cancelled */
+  if (gsound_play_is_late (self, play))
+    res = CA_ERROR_CANCELED;
+  else
+    res = gsound_context_start_play (self, play, pl);
+  if (res != CA_SUCCESS)
+    gsound_play_complete (play, res);
+
+  /* The play may be gone by now, so don't touch it */
+  if (holds_ref)
+    g_object_unref (self);
+}
+
+/* Adds @key and @value to the %NULL-terminated list @pairs, if set */
+static void
+add_trace_pair (const char **pairs,
+                guint       *n,
+                const char  *key,
+                const char  *value)
+{
+  if (!value)
+    return;
+
+  pairs[(*n)++] = key;
+  pairs[(*n)++] = value;
+}
+
+/*
+ * Records a sound in the trace, if one is being recorded. All of @attrs
+ * are recorded if given, or else just what @info knows about.
+ */
+static void
+gsound_context_trace_play (GSoundContext        *self,
+                           guint32               id,
+                           const GSoundPlayInfo *info,
+                           GSoundAttributes     *attrs)
+{
+  const char *pairs[2 * 7 + 1];
+  guint n = 0;
+
+  if (G_LIKELY (!g_atomic_int_get (&self->recording)))
+    return;
+
+  if (!attrs)
+    {
+      add_trace_pair (pairs, &n, GSOUND_ATTR_EVENT_ID, info->event_id);
+      add_trace_pair (pairs, &n, GSOUND_ATTR_MEDIA_ROLE, info->media_role);
+      add_trace_pair (pairs, &n, GSOUND_ATTR_GSOUND_PRIORITY, info->priority);
+      add_trace_pair (pairs, &n, GSOUND_ATTR_MEDIA_FILENAME,
+                      info->media_filename);
+      add_trace_pair (pairs, &n, GSOUND_ATTR_CANBERRA_XDG_THEME_NAME,
+                      info->theme_name);
+      add_trace_pair (pairs, &n, GSOUND_ATTR_CANBERRA_XDG_THEME_OUTPUT_PROFILE,
+                      info->output_profile);
+      add_trace_pair (pairs, &n, GSOUND_ATTR_MEDIA_LANGUAGE, info->language);
+    }
+  pairs[n] = NULL;
+
+  g_rec_mutex_lock (&self->lock);
+  if (self->recorder)
+    _gsound_recorder_add_play (self->recorder, id,
+                               attrs ? _gsound_attributes_get_table (attrs)
+                                     : NULL,
+                               pairs);
+  g_rec_mutex_unlock (&self->lock);
+}
+
+/*
+ * Gives a new play what it needs for the rate and voice limits. @attrs are
+ * the attributes the sound was requested with, if it had any.
+ */
+static void
+gsound_play_set_info (GSoundPlay           *play,
+                      GSoundAdmission       admission,
+                      const GSoundPlayInfo *info,
+                      GSoundAttributes     *attrs)
+{
+  gsound_context_trace_play (play->context, play->id, info, attrs);
+
+  if (play->context->null_driver)
+    play->media_filename = g_strdup (info->media_filename);
+
+  if (admission == ADMIT_PLAY_LIMITED)
+    play->limit_event = g_strdup (info->event_id);
+
+  play->priority = gsound_play_info_get_priority (info);
+  play->job.priority = play->priority;
+
+  if (g_atomic_int_get (&play->context->deadlines_enabled))
+    play->request_time = g_get_monotonic_time ();
+
+  if (info->sample)
+    play->sample = _gsound_sample_file_ref (info->sample);
+
+  if (info->playback)
+    {
+      play->playback = g_object_ref (info->playback);
+      _gsound_playback_set_id (play->playback, play->id);
+    }
+}
+
+/* Records in the cache index that the sample @event_id was played */
+static void
+gsound_context_touch_sample (GSoundContext *self,
+                             const char    *event_id)
+{
+  if (event_id)
+    _gsound_cache_index_touch (self->cache_index, event_id);
+}
+
+/*
+ * Adds the attributes pushed by this thread to @pl, outermost first, and
+ * then the values it set with gsound_context_set_attribute_double() and
+ * gsound_context_set_attribute_int()
+ */
+static int
+gsound_context_apply_scopes (GSoundContext *self,
+                             ca_proplist   *pl)
+{
+  GSoundOverlay *overlay;
+  GPtrArray *stack;
+  int res = CA_SUCCESS;
+  guint i;
+
+  if (!g_atomic_int_get (&self->n_scoped_threads))
+    return CA_SUCCESS;
+
+  g_rec_mutex_lock (&self->lock);
+
+  stack = g_hash_table_lookup (self->scopes, g_thread_self ());
+  for (i = 0; stack && i < stack->len && res == CA_SUCCESS; i++)
+    res = _gsound_attributes_copy_to_proplist (stack->pdata[i], pl);
+
+  overlay = g_hash_table_lookup (self->overlays, g_thread_self ());
+  for (i = 0; overlay && i < GSOUND_N_ATTR_IDS && res == CA_SUCCESS; i++)
+    if (overlay->values[i])
+      res = ca_proplist_sets (pl, gsound_attr_id_to_key (i),
+                              overlay->values[i]);
+
+  g_rec_mutex_unlock (&self->lock);
+
+  return res;
+}
+
+/*
+ * Creates a property list for a sound, holding the attributes pushed by
+ * this thread, which the sound's own attributes then override
+ */
+static int
+gsound_context_create_proplist (GSoundContext  *self,
+                                ca_proplist   **pl)
+{
+  int res;
+
+  res = ca_proplist_create (pl);
+  if (res != CA_SUCCESS)
+    return res;
+
+  res = gsound_context_apply_scopes (self, *pl);
+  if (res != CA_SUCCESS)
+    g_clear_pointer (pl, ca_proplist_destroy);
+
+  return res;
+}
+
+static void
+scope_info_field (const char       **field,
+                  GSoundAttributes  *attrs,
+                  GSoundAttrId       id)
+{
+  if (!*field)
+    *field = gsound_attributes_lookup_id (attrs, id);
+}
+
+/*
+ * Fills in whatever @info doesn't say about a sound from the attributes
+ * pushed by this thread, innermost first, just as they are merged into
+ * its property list. The values are borrowed from the scopes, which only
+ * this thread can pop.
+ */
+static void
+gsound_context_scope_info (GSoundContext  *self,
+                           GSoundPlayInfo *info)
+{
+  GPtrArray *stack;
+  guint i;
+
+  if (!g_atomic_int_get (&self->n_scoped_threads))
+    return;
+
+  g_rec_mutex_lock (&self->lock);
+
+  stack = g_hash_table_lookup (self->scopes, g_thread_self ());
+  for (i = stack ? stack->len : 0; i > 0; i--)
+    {
+      GSoundAttributes *attrs = stack->pdata[i - 1];
+
+      scope_info_field (&info->event_id, attrs, GSOUND_ATTR_ID_EVENT_ID);
+      scope_info_field (&info->media_role, attrs, GSOUND_ATTR_ID_MEDIA_ROLE);
+      scope_info_field (&info->priority, attrs,
+                        GSOUND_ATTR_ID_GSOUND_PRIORITY);
+      scope_info_field (&info->media_filename, attrs,
+                        GSOUND_ATTR_ID_MEDIA_FILENAME);
+      scope_info_field (&info->theme_name, attrs,
+                        GSOUND_ATTR_ID_CANBERRA_XDG_THEME_NAME);
+      scope_info_field (&info->output_profile, attrs,
+                        GSOUND_ATTR_ID_CANBERRA_XDG_THEME_OUTPUT_PROFILE);
+      scope_info_field (&info->language, attrs,
+                        GSOUND_ATTR_ID_MEDIA_LANGUAGE);
+      scope_info_field (&info->language, attrs,
+                        GSOUND_ATTR_ID_APPLICATION_LANGUAGE);
+    }
+
+  g_rec_mutex_unlock (&self->lock);
+}
+
+/*
+ * If this thread has pushed any attributes, replaces a sound given as
+ * @attrs with a new @proplist holding them as well
+ */
+static int
+gsound_context_scope_attrs (GSoundContext     *self,
+                            ca_proplist      **proplist,
+                            GSoundAttributes **attrs)
+{
+  ca_proplist *pl = NULL;
+  int res;
+
+  if (!*attrs || !g_atomic_int_get (&self->n_scoped_threads))
+    return CA_SUCCESS;
+
+  res = gsound_context_create_proplist (self, &pl);
+  if (res == CA_SUCCESS)
+    res = _gsound_attributes_copy_to_proplist (*attrs, pl);
+
+  if (res != CA_SUCCESS)
+    {
+      if (pl)
+        ca_proplist_destroy (pl);
+      return res;
+    }
+
+  *proplist = pl;
+  *attrs = NULL;
+
+  return CA_SUCCESS;
+}
+
+/*
+ * If the theme cache is on, looks up the file which the sound's event ID
+ * resolves to and gives it to libcanberra as the sound's filename, so that
+ * it doesn't search the theme itself. A sound given as @attrs is copied
+ * into a new @proplist first, and @attrs is cleared.
+ */
+static void
+gsound_context_resolve_event (GSoundContext         *self,
+                              const GSoundPlayInfo  *info,
+                              ca_proplist          **proplist,
+                              GSoundAttributes     **attrs)
+{
+  ca_proplist *pl = *proplist;
+  int res = CA_SUCCESS;
+  gchar *path;
+
+  if (!g_atomic_int_get (&self->theme_cache_enabled) ||
+      !info->event_id || info->media_filename || info->sample)
+    return;
+
+  path = _gsound_theme_cache_lookup (self->theme_cache, info->theme_name,
+                                     info->output_profile, info->language,
+                                     info->event_id);
+  if (!path)
+    return;
+
+  if (*attrs)
+    {
+      res = ca_proplist_create (&pl);
+      if (res == CA_SUCCESS)
+        res = _gsound_attributes_copy_to_proplist (*attrs, pl);
+    }
+  if (res == CA_SUCCESS)
+    res = ca_proplist_sets (pl, CA_PROP_MEDIA_FILENAME, path);
+
+  /* On failure, just leave libcanberra to find the sound */
+  if (*attrs)
+    {
+      if (res == CA_SUCCESS)
+        {
+          *proplist = pl;
+          *attrs = NULL;
+        }
+      else if (pl)
+        {
+          ca_proplist_destroy (pl);
+        }
+    }
+
+  g_free (path);
+}
+
+/*
+ * Plays a sound which has no task. Takes ownership of @proplist; exactly
+ * one of @proplist and @attrs should be given. @info describes the sound,
+ * and may only be %NULL if @attrs is used.
+ */
+static gboolean
+gsound_context_play_proplist (GSoundContext        *self,
+                              ca_proplist          *proplist,
+                              GSoundAttributes     *attrs,
+                              const GSoundPlayInfo *info,
+                              GCancellable         *cancellable,
+                              GError              **error)
+{
+  GSoundAttributes *request_attrs = attrs;
+  GSoundPlayInfo attrs_info;
+  GSoundAdmission admission;
+  const char *event_id;
+  GSoundPlay *play;
+  ca_proplist *pl;
+  int res;
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+      gsound_context_record_result (self, 0, 0, CA_ERROR_CANCELED);
+      g_clear_pointer (&proplist, ca_proplist_destroy);
+      return FALSE;
+    }
+
+  if (info)
+    attrs_info = *info;
+  else
+    gsound_play_info_from_attrs (&attrs_info, attrs);
+
+  gsound_context_scope_info (self, &attrs_info);
+  info = &attrs_info;
+
+  /* @info still borrows from @attrs, which the caller holds on to */
+  res = gsound_context_scope_attrs (self, &proplist, &attrs);
+  if (res != CA_SUCCESS)
+    return test_return (res, error);
+
+  event_id = info->event_id;
+  gsound_context_touch_sample (self, event_id);
+
+  admission = gsound_context_admit (self, event_id);
+  if (admission == ADMIT_MERGE || admission == ADMIT_DROP)
+    {
+      GError *inner_error = gsound_admission_error (admission, event_id);
+
+      g_clear_pointer (&proplist, ca_proplist_destroy);
+      if (!inner_error)
+        {
+          /* The sound counts as having played along with the other */
+          if (info->playback)
+            _gsound_playback_finish (info->playback, CA_SUCCESS);
+          return TRUE;
+        }
+
+      g_propagate_error (error, inner_error);
+      return FALSE;
+    }
+
+  gsound_context_resolve_event (self, info, &proplist, &attrs);
+
+  /* Don't make the caller wait for a lazy connection to be made */
+  if (gsound_context_ensure_connection (self))
+    {
+      play = gsound_play_new (self, cancellable, NULL);
+      play->job.run = gsound_play_run;
+      play->holds_ref = TRUE;
+      play->proplist = proplist;
+      play->attrs = attrs ? gsound_attributes_ref (attrs) : NULL;
+      gsound_play_set_info (play, admission, info, request_attrs);
+      g_object_ref (self);
+
+      gsound_context_push_jobs (self, &play->job, &play->job);
+      return TRUE;
+    }
+
+  pl = attrs ? _gsound_attributes_get_proplist (attrs) : proplist;
+
+  /*
+   * We only need to know when the sound finishes if it can be cancelled,
+   * counts towards an instance or voice limit, or has a file to close
+   */
+  if (!cancellable && admission == ADMIT_PLAY && !info->sample &&
+      !info->playback && !g_atomic_int_get (&self->max_voices))
+    {
+      guint32 id = gsound_context_next_id (self);
+      gint64 start = gsound_context_stats_now (self);
+
+      gsound_context_trace_play (self, id, info, request_attrs);
+
+      res = gsound_context_backend_play (self, id, pl, info->media_filename,
+                                         NULL);
+      gsound_context_record_submit (self, id, start, res);
+      if (res == CA_SUCCESS)
+        gsound_context_set_connected (self);
+      else
+        gsound_context_record_result (self, id, 0, res);
+    }
+  else
+    {
+      play = gsound_play_new (self, cancellable, NULL);
+      gsound_play_set_info (play, admission, info, request_attrs);
+
+      res = gsound_context_start_play (self, play, pl);
+      if (res != CA_SUCCESS)
+        {
+          gsound_context_record_result (self, play->id, 0, res);
+          gsound_play_free (play);
+        }
+    }
+
+  g_clear_pointer (&proplist, ca_proplist_destroy);
+
+  return test_return (res, error);
+}
+
+/*
+ * Queues a sound for submission from the worker thread, so that the
+ * caller never waits for the sound server. Takes ownership of @task and
+ * @proplist; exactly one of @proplist and @attrs should be given.
+ * @info describes the sound, and may only be %NULL if @attrs is used.
+ */
+static void
+gsound_context_queue_play (GSoundContext        *self,
+                           GSoundResult         *task,
+                           ca_proplist          *proplist,
+                           GSoundAttributes     *attrs,
+                           const GSoundPlayInfo *info)
+{
+  GSoundAttributes *request_attrs = attrs;
+  GSoundPlayInfo attrs_info;
+  GSoundAdmission admission;
+  GError *inner_error = NULL;
+  const char *event_id;
+  GSoundPlay *play;
+
+  if (_gsound_result_return_error_if_cancelled (task))
+    {
+      gsound_context_record_result (self, 0, 0, CA_ERROR_CANCELED);
+      g_clear_pointer (&proplist, ca_proplist_destroy);
+      g_object_unref (task);
+      return;
+    }
+
+  if (info)
+    attrs_info = *info;
+  else
+    gsound_play_info_from_attrs (&attrs_info, attrs);
+
+  gsound_context_scope_info (self, &attrs_info);
+  info = &attrs_info;
+
+  if (!test_return (gsound_context_scope_attrs (self, &proplist, &attrs),
+                    &inner_error))
+    {
+      _gsound_result_return_error (task, inner_error);
+      g_object_unref (task);
+      return;
+    }
+
+  event_id = info->event_id;
+  gsound_context_touch_sample (self, event_id);
+
+  /* Sounds which are not admitted complete straight away */
+  admission = gsound_context_admit (self, event_id);
+  if (admission == ADMIT_MERGE || admission == ADMIT_DROP)
+    {
+      GError *inner_error = gsound_admission_error (admission, event_id);
+
+      if (inner_error)
+        _gsound_result_return_error (task, inner_error);
+      else
+        _gsound_result_return_boolean (task, TRUE);
+
+      g_clear_pointer (&proplist, ca_proplist_destroy);
+      g_object_unref (task);
+      return;
+    }
+
+  gsound_context_resolve_event (self, info, &proplist, &attrs);
+  gsound_context_ensure_connection (self);
+
+  play = gsound_play_new (self, _gsound_result_get_cancellable (task), task);
+  play->job.run = gsound_play_run;
+  play->proplist = proplist;
+  play->attrs = attrs ? gsound_attributes_ref (attrs) : NULL;
+  gsound_play_set_info (play, admission, info, request_attrs);
+
+  gsound_context_push_jobs (self, &play->job, &play->job);
+}
+
+/*
+ * Adds a sample which has just been cached to the index. The server names
+ * its samples by event ID; we only know the size if a file was given.
+ */
+static void
+gsound_context_index_sample (GSoundContext    *self,
+                             GSoundAttributes *attrs)
+{
+  const char *event_id, *filename;
+  guint64 size = 0;
+
+  event_id = gsound_attributes_lookup (attrs, GSOUND_ATTR_EVENT_ID);
+  if (!event_id)
+    return;
+
+  filename = gsound_attributes_lookup (attrs, GSOUND_ATTR_MEDIA_FILENAME);
+  if (filename)
+    {
+      GStatBuf buf;
+
+      if (g_stat (filename, &buf) == 0)
+        size = buf.st_size;
+    }
+
+  _gsound_cache_index_insert (self->cache_index, event_id, size);
+}
+
+/**
+ * gsound_context_new:
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @error: Return location for error
+ *
+ * Creates and initializes a new #GSoundContext. If the an error occured
+ * during initialization, #NULL is returned and @error will be set
+ * appropriately.
+ *
+ * Returns: (transfer full): A new #GSoundContext
+ */
+GSoundContext *
+gsound_context_new (GCancellable *cancellable, GError **error)
+{
+  return GSOUND_CONTEXT (g_initable_new (GSOUND_TYPE_CONTEXT,
+                                         cancellable,
+                                         error,
+                                         NULL));
+}
+
+static void
+shared_entry_free (gpointer data)
+{
+  g_weak_ref_clear (data);
+  g_slice_free (GWeakRef, data);
+}
+
+/**
+ * gsound_context_get_shared:
+ * @key: (allow-none): The name of the shared context, or %NULL for the
+ *   default one
+ * @error: Return location for error
+ *
+ * Gets the context shared by everything in the process which asks for
+ * @key, creating it if necessary. Sharing a context means sharing its
+ * connection to the sound server and the samples it has cached, so this
+ * is the best choice for plugins and other components which would
+ * otherwise each create a context of their own.
+ *
+ * A shared context lives as long as somebody holds a reference to it, and
+ * is created again if it is asked for after that.
+ *
+ * Like gsound_context_new(), the context is tied to the thread-default
+ * #GMainContext of the thread which creates it, which here means whichever
+ * caller asks for @key first. Theme changes are noticed, and the signals
+ * of #GSoundPlayback handles are emitted, in that main context only, so it
+ * should be one which keeps running, usually the application's main one.
+ * The callbacks of asynchronous functions are not affected and are invoked
+ * in the caller's thread-default main context as usual.
+ *
+ * Since the attributes of a shared context apply to every sound played on
+ * it, components should not change them with
+ * gsound_context_set_attributes(). Attributes which only concern one
+ * component should be given with each sound instead, most cheaply by
+ * building a #GSoundAttributes once and playing it with
+ * gsound_context_play_attrs(), or pushed for a stretch of code with
+ * gsound_context_push_attributes(), which only affects the calling thread.
+ *
+ * This function is thread-safe.
+ *
+ * Returns: (transfer full): The shared #GSoundContext, or %NULL on error
+ */
+GSoundContext *
+gsound_context_get_shared (const char  *key,
+                           GError     **error)
+{
+  static GMutex lock;
+  static GHashTable *pool;
+  GSoundContext *self;
+  GWeakRef *ref;
+
+  if (!key)
+    key = "default";
+
+  g_mutex_lock (&lock);
+
+  if (!pool)
+    pool = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                  g_free, shared_entry_free);
+
+  ref = g_hash_table_lookup (pool, key);
+  self = ref ? g_weak_ref_get (ref) : NULL;
+
+  if (!self)
+    {
+      self = gsound_context_new (NULL, error);
+      if (self)
+        {
+          if (!ref)
+            {
+              ref = g_slice_new (GWeakRef);
+              g_weak_ref_init (ref, NULL);
+              g_hash_table_insert (pool, g_strdup (key), ref);
+            }
+          g_weak_ref_set (ref, self);
+        }
+    }
+
+  g_mutex_unlock (&lock);
+
+  return self;
+}
+
+/**
+ * gsound_context_get_default:
+ * @error: Return location for error
+ *
+ * Gets the context shared by the whole process. This is the same as
+ * calling gsound_context_get_shared() with a %NULL key.
+ *
+ * Returns: (transfer full): The default #GSoundContext, or %NULL on error
+ */
+GSoundContext *
+gsound_context_get_default (GError **error)
+{
+  return gsound_context_get_shared (NULL, error);
+}
+
+/**
+ * gsound_context_open:
+ * @context: A #GSoundContext
+ * @error: Return location for error
+ *
+ * Attempts to open a connection to the backend sound driver. It is recommended
+ * that you set context attributes with gsound_context_set_attributes() before
+ * calling this function.
+ *
+ * > A connection is automatically opened before playing or caching sounds,
+ * > so you rarely need to call this yourself.
+ *
+ * Returns: %TRUE if the output device was opened successfully, or %FALSE
+ *          (populating @error)
+ */
+gboolean
+gsound_context_open (GSoundContext *self, GError **error)
+{
+  int res;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  res = gsound_context_backend_open (self);
+
+  if (res == CA_SUCCESS)
+    gsound_context_set_connected (self);
+  else
+    g_atomic_int_compare_and_exchange (&self->connection,
+                                       CONNECTION_PENDING,
+                                       CONNECTION_NONE);
+
+  return test_return (res, error);
+}
+
+static void
+gsound_context_open_job (GSoundContext *self,
+                         GSoundJob     *job)
+{
+  GTask *task = ((GSoundTaskJob *) job)->task;
+  GError *error = NULL;
+
+  g_slice_free (GSoundTaskJob, (GSoundTaskJob *) job);
+
+  /*
+   * Both gsound_context_open_async() and a lazy sound may have queued an
+   * open; whichever runs second has nothing left to do
+   */
+  if (g_atomic_int_get (&self->connection) == CONNECTION_OPEN)
+    {
+      if (task)
+        {
+          g_task_return_boolean (task, TRUE);
+          g_object_unref (task);
+        }
+      else
+        g_object_unref (self);
+      return;
+    }
+
+  /* A lazy connection, made on behalf of the first sound */
+  if (!task)
+    {
+      if (!gsound_context_open (self, &error))
+        {
+          g_debug ("Failed to open connection: %s", error->message);
+          g_clear_error (&error);
+        }
+
+      g_object_unref (self);
+      return;
+    }
+
+  if (g_task_return_error_if_cancelled (task))
+    g_atomic_int_compare_and_exchange (&self->connection,
+                                       CONNECTION_PENDING,
+                                       CONNECTION_NONE);
+  else if (gsound_context_open (self, &error))
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+
+  g_object_unref (task);
+}
+
+/**
+ * gsound_context_set_lazy:
+ * @context: A #GSoundContext
+ * @lazy: Whether to defer connecting to the sound server
+ *
+ * Sets whether @context connects to the sound server lazily. In lazy
+ * mode, nothing is sent to the sound server until the first sound is
+ * played. The connection is then made from the context's worker thread,
+ * and sounds played while it is being made are queued behind it rather
+ * than making the caller wait.
+ *
+ * Note that, while the connection is being made, gsound_context_play_simple()
+ * and gsound_context_play_attrs() cannot report errors from the sound
+ * server, and will always succeed.
+ *
+ * Lazy mode is off by default.
+ */
+void
+gsound_context_set_lazy (GSoundContext *self,
+                         gboolean       lazy)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  g_atomic_int_set (&self->lazy, !!lazy);
+}
+
+/**
+ * gsound_context_set_warm_up_events:
+ * @context: A #GSoundContext
+ * @event_ids: (array zero-terminated=1) (allow-none): A %NULL-terminated
+ *   array of event sound IDs, or %NULL
+ *
+ * Sets a list of event sounds to be cached in the background as soon as
+ * @context is connected to the sound server, so that they play with low
+ * latency the first time they are needed. If @context is already
+ * connected, caching starts immediately.
+ *
+ * This replaces any list which has not been cached yet. The sounds are
+ * cached as if by gsound_context_cache() with only #GSOUND_ATTR_EVENT_ID
+ * set, and any errors are ignored.
+ */
+void
+gsound_context_set_warm_up_events (GSoundContext      *self,
+                                   const char * const *event_ids)
+{
+  gboolean connected;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  g_rec_mutex_lock (&self->lock);
+  g_strfreev (self->warm_up_events);
+  self->warm_up_events = event_ids && event_ids[0]
+                         ? g_strdupv ((gchar **) event_ids) : NULL;
+  g_rec_mutex_unlock (&self->lock);
+
+  connected = g_atomic_int_get (&self->connection) == CONNECTION_OPEN;
+  if (connected)
+    gsound_context_schedule_warm_up (self);
+}
+
+/**
+ * gsound_context_open_async:
+ * @context: A #GSoundContext
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @callback: (scope async): callback
+ * @user_data: User data passed to @callback
+ *
+ * Asynchronously opens a connection to the backend sound driver. The
+ * connection is made from the context's worker thread, so this never
+ * blocks the caller.
+ *
+ * Sounds passed to gsound_context_play_full() and friends while the
+ * connection is being opened are held back, and are submitted as soon as
+ * it completes.
+ */
+void
+gsound_context_open_async (GSoundContext      *self,
+                           GCancellable       *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer            user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gsound_context_open_async);
+
+  /* So that lazy sounds queue behind this rather than opening again */
+  g_atomic_int_compare_and_exchange (&self->connection,
+                                     CONNECTION_NONE,
+                                     CONNECTION_PENDING);
+
+  gsound_context_queue_task (self, task, gsound_context_open_job);
+}
+
+/**
+ * gsound_context_open_finish:
+ * @context: A #GSoundContext
+ * @result: Result object passed to the callback of
+ *   gsound_context_open_async()
+ * @error: Return location for error
+ *
+ * Finish an async operation started by gsound_context_open_async().
+ *
+ * Returns: %TRUE if the output device was opened successfully, or %FALSE
+ *          (populating @error)
+ */
+gboolean
+gsound_context_open_finish (GSoundContext *self,
+                            GAsyncResult  *result,
+                            GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * gsound_context_set_event_limit:
+ * @context: A #GSoundContext
+ * @event_id: (allow-none): The event ID to limit, or %NULL to set the
+ *   default for every event ID which has no limit of its own
+ * @min_interval: The shortest time in milliseconds between two sounds
+ *   with this event ID starting, or 0 for no minimum
+ * @max_instances: The most sounds with this event ID which may play at
+ *   once, or 0 for no maximum
+ * @mode: What to do with sounds which break the limit
+ *
+ * Limits how often sounds with the given #GSOUND_ATTR_EVENT_ID may be
+ * played, to stop bursts of the same event from swamping the sound
+ * server. Sounds without an event ID are never limited.
+ *
+ * A sound which breaks the limit is not passed to the sound server, and
+ * the call which requested it completes immediately. With
+ * %GSOUND_COALESCE_MERGE it succeeds, as if it had joined the sound which
+ * is already playing; with %GSOUND_COALESCE_DROP it fails with
+ * %G_IO_ERROR_BUSY.
+ *
+ * Setting both @min_interval and @max_instances to 0 removes the limit.
+ */
+void
+gsound_context_set_event_limit (GSoundContext      *self,
+                                const char         *event_id,
+                                guint               min_interval,
+                                guint               max_instances,
+                                GSoundCoalesceMode  mode)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  g_rec_mutex_lock (&self->lock);
+
+  if (event_id)
+    {
+      GSoundEventLimit *limit;
+
+      limit = g_hash_table_lookup (self->event_limits, event_id);
+      if (!limit)
+        {
+          limit = g_slice_new0 (GSoundEventLimit);
+          g_hash_table_insert (self->event_limits, g_strdup (event_id), limit);
+        }
+
+      /* Keep the entry even if unlimited, as it may have sounds playing */
+      limit->configured = min_interval != 0 || max_instances != 0;
+      limit->min_interval = min_interval;
+      limit->max_instances = max_instances;
+      limit->mode = mode;
+    }
+  else
+    {
+      self->default_interval = min_interval;
+      self->default_max_instances = max_instances;
+      self->default_mode = mode;
+    }
+
+  g_atomic_int_set (&self->limits_enabled, TRUE);
+
+  g_rec_mutex_unlock (&self->lock);
+}
+
+/**
+ * gsound_context_set_max_voices:
+ * @context: A #GSoundContext
+ * @max_voices: The most sounds which may play at once, or 0 for no limit
+ *
+ * Limits how many sounds @context may have playing at once. When every
+ * voice is in use, a new sound steals the voice of the lowest priority
+ * sound which is playing (the oldest, if several share that priority),
+ * which is cancelled. If every playing sound has a higher priority than
+ * the new one, the new sound is not played, and fails with
+ * %GSOUND_ERROR_CANCELED exactly as if it had been stolen.
+ *
+ * The priority of a sound is given by #GSOUND_ATTR_GSOUND_PRIORITY, or
+ * else guessed from #GSOUND_ATTR_MEDIA_ROLE: "phone" and "a11y" sounds are
+ * high priority, "game", "animation" and "test" sounds low, and everything
+ * else normal.
+ *
+ * Lowering the limit doesn't stop any sounds straight away; the excess
+ * voices are reclaimed when the next sound is played.
+ *
+ * Sounds which were started while there was no limit are not counted as
+ * using a voice, so they can't be stolen, and a new limit only counts the
+ * sounds played after it was set.
+ */
+void
+gsound_context_set_max_voices (GSoundContext *self,
+                               guint          max_voices)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  g_atomic_int_set (&self->max_voices, max_voices);
+}
+
+/**
+ * gsound_context_set_deadline:
+ * @context: A #GSoundContext
+ * @priority: The priority of the sounds to limit
+ * @msec: How long sounds may wait, in milliseconds, or 0 for no limit
+ *
+ * Limits how long sounds of @priority may wait to be handed to the sound
+ * server. A sound which has waited longer than that, for example because
+ * the server is slow or many other sounds were played at the same time,
+ * is not played at all, and fails with %GSOUND_ERROR_CANCELED. This
+ * suits sounds which only make sense straight away, such as the click of
+ * a button, which is better dropped than heard late.
+ *
+ * Waiting sounds are always submitted in order of priority, so high
+ * priority sounds jump ahead of any normal or low priority ones. See
+ * gsound_context_set_max_voices() for how a sound's priority is decided.
+ *
+ * The deadline applies to sounds played after it is set. Sounds which
+ * could be submitted immediately never wait, and so are never dropped.
+ */
+void
+gsound_context_set_deadline (GSoundContext  *self,
+                             GSoundPriority  priority,
+                             guint           msec)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (priority <= GSOUND_PRIORITY_HIGH);
+  g_return_if_fail (msec <= G_MAXINT);
+
+  g_atomic_int_set (&self->deadlines[priority], msec);
+  if (msec)
+    g_atomic_int_set (&self->deadlines_enabled, TRUE);
+}
+
+/**
+ * gsound_context_push_attributes:
+ * @context: A #GSoundContext
+ * @attrs: The attributes to add
+ *
+ * Adds @attrs to every sound which the calling thread plays on @context,
+ * until it is removed again by gsound_context_pop_attributes(). This is a
+ * cheap way to give sounds defaults which depend on what the thread is
+ * doing, such as the #GSOUND_ATTR_WINDOW_ID of the window being handled:
+ * unlike gsound_context_set_attributes(), nothing is sent to the sound
+ * server, and other threads are not affected.
+ *
+ * Pushes nest, with later pushes overriding earlier ones, and the sound's
+ * own attributes override them all. Every push must be matched by a pop
+ * before the thread exits.
+ */
+void
+gsound_context_push_attributes (GSoundContext    *self,
+                                GSoundAttributes *attrs)
+{
+  GPtrArray *stack;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (attrs != NULL);
+
+  g_rec_mutex_lock (&self->lock);
+
+  stack = g_hash_table_lookup (self->scopes, g_thread_self ());
+  if (!stack)
+    {
+      stack = g_ptr_array_new_with_free_func ((GDestroyNotify)
+                                              gsound_attributes_unref);
+      g_hash_table_insert (self->scopes, g_thread_self (), stack);
+      g_atomic_int_inc (&self->n_scoped_threads);
+    }
+
+  g_ptr_array_add (stack, gsound_attributes_ref (attrs));
+
+  g_rec_mutex_unlock (&self->lock);
+}
+
+/**
+ * gsound_context_pop_attributes:
+ * @context: A #GSoundContext
+ *
+ * Removes the attributes most recently added by the calling thread with
+ * gsound_context_push_attributes().
+ */
+void
+gsound_context_pop_attributes (GSoundContext *self)
+{
+  GPtrArray *stack;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  g_rec_mutex_lock (&self->lock);
+
+  stack = g_hash_table_lookup (self->scopes, g_thread_self ());
+  if (!stack)
+    {
+      g_rec_mutex_unlock (&self->lock);
+      g_critical ("gsound_context_pop_attributes() called without a push");
+      return;
+    }
+
+  g_ptr_array_remove_index (stack, stack->len - 1);
+  if (stack->len == 0)
+    {
+      g_hash_table_remove (self->scopes, g_thread_self ());
+      g_atomic_int_add (&self->n_scoped_threads, -1);
+    }
+
+  g_rec_mutex_unlock (&self->lock);
+}
+
+/**
+ * gsound_context_set_theme_cache_enabled:
+ * @context: A #GSoundContext
+ * @enabled: Whether to cache sound theme lookups
+ *
+ * Sets whether @context remembers which file each #GSOUND_ATTR_EVENT_ID
+ * resolves to in the sound theme. Normally libcanberra searches the theme
+ * directories every time an event sound is played; with the cache enabled,
+ * GSound does the search once for each combination of theme, output
+ * profile, language and event ID, and then passes the file straight to
+ * libcanberra. Sounds which set #GSOUND_ATTR_MEDIA_FILENAME themselves are
+ * left alone.
+ *
+ * The theme directories are watched, and the cache is emptied whenever
+ * they change. Changes are noticed when the thread-default main context of
+ * the thread which created @context runs.
+ *
+ * The cache is disabled by default.
+ */
+void
+gsound_context_set_theme_cache_enabled (GSoundContext *self,
+                                        gboolean       enabled)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  g_atomic_int_set (&self->theme_cache_enabled, enabled);
+}
+
+/* How many threads run callbacks for GSOUND_DISPATCH_THREAD_POOL */
+#define DISPATCH_POOL_THREADS 4
+
+/**
+ * gsound_context_set_completion_dispatch:
+ * @context: A #GSoundContext
+ * @mode: Where to invoke the callbacks of sounds
+ * @main_context: (allow-none): The #GMainContext to use with
+ *   %GSOUND_DISPATCH_MAIN_CONTEXT, or %NULL for the global default
+ *
+ * Sets where @context invokes the callbacks passed to
+ * gsound_context_play_full() and the other asynchronous play functions.
+ * By default, as with any other asynchronous function, a callback is
+ * invoked in the thread-default main context of the thread which started
+ * the sound. An application which plays many sounds from one thread may
+ * prefer not to wake that thread every time a sound finishes.
+ *
+ * With %GSOUND_DISPATCH_DIRECT, callbacks are invoked immediately, in
+ * whichever thread finds out that the sound has finished. This is usually
+ * an internal thread of the sound server connection, so callbacks must be
+ * quick and thread-safe, and must not block. A sound which fails straight
+ * away may invoke its callback before the play function returns.
+ *
+ * The setting applies to sounds started after it is changed. It does not
+ * affect the callbacks of gsound_context_open_async() or
+ * gsound_context_cache_async(), which are always invoked in the usual way.
+ */
+void
+gsound_context_set_completion_dispatch (GSoundContext     *self,
+                                        GSoundDispatchMode mode,
+                                        GMainContext      *main_context)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (mode >= GSOUND_DISPATCH_THREAD_DEFAULT &&
+                    mode <= GSOUND_DISPATCH_DIRECT);
+
+  g_rec_mutex_lock (&self->lock);
+
+  self->dispatch.mode = mode;
+
+  g_clear_pointer (&self->dispatch.main_context, g_main_context_unref);
+  if (mode == GSOUND_DISPATCH_MAIN_CONTEXT)
+    {
+      if (!main_context)
+        main_context = g_main_context_default ();
+      self->dispatch.main_context = g_main_context_ref (main_context);
+    }
+
+  /* Results are finished with inside the pool, so it lives as long as we do */
+  if (mode == GSOUND_DISPATCH_THREAD_POOL && !self->dispatch.pool)
+    self->dispatch.pool = g_thread_pool_new (_gsound_result_pool_func, NULL,
+                                             DISPATCH_POOL_THREADS,
+                                             FALSE, NULL);
+
+  g_rec_mutex_unlock (&self->lock);
+}
+
+/**
+ * gsound_context_set_driver:
+ * @context: A #GSoundContext
+ * @driver: libcanberra driver to use
+ * @error: Return location for error, or %NULL
+ *
+ * Sets the libcanberra driver to @driver, for example "pulse", "alsa" or "null".
+ * You normally do not need to set this yourself.
+ *
+ * @driver may also be #GSOUND_DRIVER_NULL, which plays nothing at all and
+ * needs no sound server; see gsound_context_set_simulated_duration(). It
+ * can only be chosen before the connection is opened, and cannot be
+ * changed afterwards.
+ *
+ * Note that this function may return %TRUE even if the specified driver is
+ * not available: see the libcanberra documentation for details.
+ *
+ * Returns: %TRUE if the libcanberra driver was set successfully
+ */
+gboolean
+gsound_context_set_driver (GSoundContext *self,
+                           const char    *driver,
+                           GError       **error)
+{
+  int res = CA_SUCCESS;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  if (g_strcmp0 (driver, GSOUND_DRIVER_NULL) != 0)
+    {
+      if (self->null_driver)
+        return test_return (CA_ERROR_STATE, error);
+
+      return test_return (ca_context_set_driver (self->ca, driver), error);
+    }
+
+  g_rec_mutex_lock (&self->lock);
+  if (g_atomic_int_get (&self->connection) != CONNECTION_NONE)
+    res = CA_ERROR_STATE;
+  else if (!self->null_driver)
+    self->null_driver = _gsound_null_driver_new ();
+  g_rec_mutex_unlock (&self->lock);
+
+  return test_return (res, error);
+}
+
+/**
+ * gsound_context_set_simulated_duration:
+ * @context: A #GSoundContext
+ * @msec: How long sounds play for, in milliseconds
+ *
+ * Sets how long each sound takes to play with #GSOUND_DRIVER_NULL, when
+ * GSound can't work out how long the sound really is. The length of WAV
+ * files, including sounds given to gsound_context_play_bytes(), is read
+ * from their headers; anything else, such as a sound from the sound theme,
+ * takes @msec. The default is 500 milliseconds.
+ *
+ * This has no effect unless the driver has already been set to
+ * #GSOUND_DRIVER_NULL with gsound_context_set_driver().
+ */
+void
+gsound_context_set_simulated_duration (GSoundContext *self,
+                                       guint          msec)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  if (self->null_driver)
+    _gsound_null_driver_set_duration (self->null_driver, msec);
+}
+
+/**
+ * gsound_context_start_recording:
+ * @context: A #GSoundContext
+ *
+ * Starts recording a trace of the sounds played on @context, with any
+ * driver. Each sound is recorded with the time it was requested and its
+ * attributes, along with when it was handed to the sound server and when
+ * it finished, and the result of each. The trace can be saved with
+ * gsound_context_stop_recording() and played back later, for example on
+ * a context using #GSOUND_DRIVER_NULL, with gsound_context_replay().
+ *
+ * Sounds played with gsound_context_play_simple() and friends are recorded
+ * with just the attributes GSound itself looks at, such as
+ * #GSOUND_ATTR_EVENT_ID, and sounds which nobody waits for have no finish
+ * time. Sounds played from a #GSoundAttributes are recorded in full.
+ *
+ * Starting a recording throws away any trace which had not been saved.
+ */
+void
+gsound_context_start_recording (GSoundContext *self)
+{
+  GSoundRecorder *old;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  g_rec_mutex_lock (&self->lock);
+  old = self->recorder;
+  self->recorder = _gsound_recorder_new ();
+  g_atomic_int_set (&self->recording, TRUE);
+  g_rec_mutex_unlock (&self->lock);
+
+  if (old)
+    _gsound_recorder_free (old);
+}
+
+/**
+ * gsound_context_stop_recording:
+ * @context: A #GSoundContext
+ * @filename: (type filename) (allow-none): Where to save the trace, or
+ *   %NULL to throw it away
+ * @error: Return location for error, or %NULL
+ *
+ * Stops the recording started by gsound_context_start_recording(), and
+ * saves the trace to @filename.
+ *
+ * Returns: %TRUE if the trace was saved, or there was nothing to do
+ */
+gboolean
+gsound_context_stop_recording (GSoundContext *self,
+                               const char    *filename,
+                               GError       **error)
+{
+  GSoundRecorder *recorder;
+  gboolean success = TRUE;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  g_rec_mutex_lock (&self->lock);
+  recorder = self->recorder;
+  self->recorder = NULL;
+  g_atomic_int_set (&self->recording, FALSE);
+  g_rec_mutex_unlock (&self->lock);
+
+  if (!recorder)
+    return TRUE;
+
+  if (filename)
+    success = _gsound_recorder_save (recorder, filename, error);
+
+  _gsound_recorder_free (recorder);
+
+  return success;
+}
+
+/**
+ * gsound_context_replay:
+ * @context: A #GSoundContext
+ * @filename: (type filename): A trace saved by
+ *   gsound_context_stop_recording()
+ * @speed: How many times faster than recorded to play the sounds, or 0
+ *   to play them as quickly as possible
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @error: Return location for error, or %NULL
+ *
+ * Plays each of the sounds in the trace @filename with the attributes they
+ * were recorded with, keeping to the timing of the trace (scaled by
+ * @speed). This blocks until the last sound has been started, so it is
+ * meant for load-testing tools rather than applications. Sounds which
+ * fail to play are skipped; use gsound_context_get_stats() to find out
+ * how many there were.
+ *
+ * Returns: %TRUE if the whole trace was played, or %FALSE if it could not
+ *   be read or @cancellable was cancelled
+ */
+gboolean
+gsound_context_replay (GSoundContext *self,
+                       const char    *filename,
+                       gdouble        speed,
+                       GCancellable  *cancellable,
+                       GError       **error)
+{
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (speed >= 0, FALSE);
+
+  return _gsound_recorder_replay (self, filename, speed, cancellable, error);
+}
+
+/* Remembers the theme settings from the context's own attributes */
+static void
+gsound_context_set_theme_defaults (GSoundContext        *self,
+                                   const GSoundPlayInfo *info)
+{
+  _gsound_theme_cache_set_defaults (self->theme_cache, info->theme_name,
+                                    info->output_profile, info->language);
+}
+
+/**
+ * gsound_context_set_attributes: (skip)
+ * @context: A #GSoundContext
+ * @error: Return location for error
+ * @...: %NULL terminated list of attribute name-value pairs
+ *
+ * Set attributes or change attributes on @context. Subsequent calls to this
+ * function calling the same attributes will override the earlier values.
+ *
+ * Note that GSound will set the #GSOUND_ATTR_APPLICATION_NAME and
+ * #GSOUND_ATTR_APPLICATION_ID for you if using #GApplication, so you do
+ * not normally need to set these yourself.
+ *
+ * Returns: %TRUE if attributes were updated successfully
+ */
+gboolean
+gsound_context_set_attributes (GSoundContext *self,
+                               GError       **error,
+                               ...)
+{
+  GSoundPlayInfo info = { NULL, };
+  gboolean valid;
+  ca_proplist *pl;
+  va_list args;
+  int res;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  if ((res = ca_proplist_create (&pl)) != CA_SUCCESS)
+    return test_return (res, error);
+
+  va_start (args, error);
+  valid = var_args_to_prop_list (args, pl, &info, error);
+  va_end (args);
+
+  if (!valid)
+    {
+      ca_proplist_destroy (pl);
+      return FALSE;
+    }
+
+  res = ca_context_change_props_full (self->ca, pl);
+  if (res == CA_SUCCESS)
+    gsound_context_set_theme_defaults (self, &info);
+
+  g_clear_pointer (&pl, ca_proplist_destroy);
+
+  return test_return (res, error);
+}
+
+/**
+ * gsound_context_set_attributesv: (rename-to gsound_context_set_attributes)
+ * @context: A #GSoundContext
+ * @attrs: (element-type utf8 utf8): Hash table of attributes to set
+ * @error: Return location for error, or %NULL
+ *
+ * Set attributes or change attributes on @context. Subsequent calls to this
+ * function calling the same attributes will override the earlier values.
+ *
+ * Note that GSound will set the #GSOUND_ATTR_APPLICATION_NAME and
+ * #GSOUND_ATTR_APPLICATION_ID for you if using #GApplication, so you do
+ * not normally need to set these yourself.
+ * 
+ * This function is intented to be used by language bindings.
+ *
+ * Returns: %TRUE if attributes were updated successfully
+ */
+gboolean
+gsound_context_set_attributesv (GSoundContext *self,
+                                GHashTable    *attrs,
+                                GError       **error)
+{
+  ca_proplist *pl;
+  int res;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  res = ca_proplist_create (&pl);
+  if (!test_return (res, error))
+    return FALSE;
+
+  if (!hash_table_to_prop_list (attrs, pl, error))
+    {
+      ca_proplist_destroy (pl);
+      return FALSE;
+    }
+
+  res = ca_context_change_props_full (self->ca, pl);
+  if (res == CA_SUCCESS)
+    {
+      GSoundPlayInfo info;
+
+      gsound_play_info_from_hash_table (&info, attrs);
+      gsound_context_set_theme_defaults (self, &info);
+    }
+
+  g_clear_pointer (&pl, ca_proplist_destroy);
+
+  return test_return (res, error);
+}
+
+/*
+ * Sets @id to @value for sounds played by this thread, or unsets it if
+ * @value is %NULL. Nothing is sent to the sound server.
+ */
+static void
+gsound_context_set_overlay_value (GSoundContext *self,
+                                  GSoundAttrId   id,
+                                  const char    *value)
+{
+  GSoundOverlay *overlay;
+
+  g_rec_mutex_lock (&self->lock);
+
+  overlay = g_hash_table_lookup (self->overlays, g_thread_self ());
+  if (!overlay && value)
+    {
+      overlay = g_slice_new0 (GSoundOverlay);
+      g_hash_table_insert (self->overlays, g_thread_self (), overlay);
+      g_atomic_int_inc (&self->n_scoped_threads);
+    }
+
+  if (!overlay || g_strcmp0 (overlay->values[id], value) == 0)
+    {
+      g_rec_mutex_unlock (&self->lock);
+      return;
+    }
+
+  if (!overlay->values[id])
+    overlay->n_set++;
+  else if (!value)
+    overlay->n_set--;
+
+  g_free (overlay->values[id]);
+  overlay->values[id] = g_strdup (value);
+
+  if (overlay->n_set == 0)
+    {
+      g_hash_table_remove (self->overlays, g_thread_self ());
+      g_atomic_int_add (&self->n_scoped_threads, -1);
+    }
+
+  g_rec_mutex_unlock (&self->lock);
+}
+
+/**
+ * gsound_context_set_attribute_double:
+ * @context: A #GSoundContext
+ * @id: The attribute to set, one of %GSOUND_ATTR_ID_EVENT_MOUSE_HPOS,
+ *   %GSOUND_ATTR_ID_EVENT_MOUSE_VPOS, %GSOUND_ATTR_ID_WINDOW_HPOS,
+ *   %GSOUND_ATTR_ID_WINDOW_VPOS or %GSOUND_ATTR_ID_CANBERRA_VOLUME
+ * @value: The new value. Positions must be between 0 and 1
+ * @error: Return location for error, or %NULL
+ *
+ * Sets a numeric attribute for every sound which the calling thread plays
+ * on @context, without formatting and checking a string. Like
+ * gsound_context_push_attributes(), the value is kept by GSound and added
+ * to each sound as it is played, so nothing is sent to the sound server
+ * and other threads are not affected. This makes it cheap to call whenever
+ * a position changes.
+ *
+ * The value overrides any pushed attributes, and the sound's own attributes
+ * override it. It applies to sounds played afterwards; the sound server
+ * cannot move a sound once it has started. Every value set must be unset
+ * with gsound_context_unset_attribute() before the thread exits.
+ *
+ * Returns: %TRUE if the attribute was set, or %FALSE with @error set
+ */
+gboolean
+gsound_context_set_attribute_double (GSoundContext *self,
+                                     GSoundAttrId   id,
+                                     gdouble        value,
+                                     GError       **error)
+{
+  char buf[G_ASCII_DTOSTR_BUF_SIZE];
+  gboolean valid;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  switch (id)
+    {
+    case GSOUND_ATTR_ID_EVENT_MOUSE_HPOS:
+    case GSOUND_ATTR_ID_EVENT_MOUSE_VPOS:
+    case GSOUND_ATTR_ID_WINDOW_HPOS:
+    case GSOUND_ATTR_ID_WINDOW_VPOS:
+      valid = value >= 0.0 && value <= 1.0;
+      break;
+    case GSOUND_ATTR_ID_CANBERRA_VOLUME:
+      valid = value >= -G_MAXDOUBLE && value <= G_MAXDOUBLE;
+      break;
+    default:
+      g_return_val_if_reached (FALSE);
+    }
+
+  if (!valid)
+    {
+      g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                   "Invalid value %g for attribute \"%s\"",
+                   value, gsound_attr_id_to_key (id));
+      return FALSE;
+    }
+
+  g_ascii_formatd (buf, sizeof buf, "%g", value);
+  gsound_context_set_overlay_value (self, id, buf);
+
+  return TRUE;
+}
+
+/**
+ * gsound_context_set_attribute_int:
+ * @context: A #GSoundContext
+ * @id: The attribute to set, for example %GSOUND_ATTR_ID_WINDOW_X or
+ *   %GSOUND_ATTR_ID_EVENT_MOUSE_Y
+ * @value: The new value
+ * @error: Return location for error, or %NULL
+ *
+ * Sets an integer attribute on @context. This works in the same way as
+ * gsound_context_set_attribute_double(), for the standard attributes
+ * which take a whole number: the mouse and window coordinates and sizes,
+ * the mouse button, the X11 screen and monitor, and the process ID.
+ *
+ * Returns: %TRUE if the attribute was set, or %FALSE with @error set
+ */
+gboolean
+gsound_context_set_attribute_int (GSoundContext *self,
+                                  GSoundAttrId   id,
+                                  gint           value,
+                                  GError       **error)
+{
+  char buf[16];
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  switch (id)
+    {
+    case GSOUND_ATTR_ID_EVENT_MOUSE_X:
+    case GSOUND_ATTR_ID_EVENT_MOUSE_Y:
+    case GSOUND_ATTR_ID_EVENT_MOUSE_BUTTON:
+    case GSOUND_ATTR_ID_WINDOW_X:
+    case GSOUND_ATTR_ID_WINDOW_Y:
+    case GSOUND_ATTR_ID_WINDOW_WIDTH:
+    case GSOUND_ATTR_ID_WINDOW_HEIGHT:
+    case GSOUND_ATTR_ID_WINDOW_X11_SCREEN:
+    case GSOUND_ATTR_ID_WINDOW_X11_MONITOR:
+    case GSOUND_ATTR_ID_APPLICATION_PROCESS_ID:
+      break;
+    default:
+      g_return_val_if_reached (FALSE);
+    }
+
+  g_snprintf (buf, sizeof buf, "%d", value);
+  gsound_context_set_overlay_value (self, id, buf);
+
+  return TRUE;
+}
+
+/**
+ * gsound_context_unset_attribute:
+ * @context: A #GSoundContext
+ * @id: The attribute to unset
+ *
+ * Removes a value set by the calling thread with
+ * gsound_context_set_attribute_double() or
+ * gsound_context_set_attribute_int(). Unsetting an attribute which was not
+ * set does nothing.
+ */
+void
+gsound_context_unset_attribute (GSoundContext *self,
+                                GSoundAttrId   id)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (id > GSOUND_ATTR_ID_INVALID && id < GSOUND_N_ATTR_IDS);
+
+  gsound_context_set_overlay_value (self, id, NULL);
+}
+
+/**
+ * gsound_context_play_simple: (skip)
+ * @context: A #GSoundContext
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @error: Return location for error, or %NULL
+ * @...: A %NULL-terminated list of attribute-value pairs
+ *
+ * The basic "fire-and-forget" play command. This function will not block, and
+ * just sends a request to the sound server before immediately returning.
+ *
+ * If you need to know when a sound finishes playing then you should call
+ * gsound_context_play_full() instead.
+ *
+ * You can cancel playback at any time by calling g_cancellable_cancel() on
+ * @cancellable, if supplied. 
+ *
+ * Returns: %TRUE on success, or %FALSE, populating @error
+ */
+gboolean
+gsound_context_play_simple (GSoundContext *self,
+                            GCancellable  *cancellable,
+                            GError       **error,
+                            ...)
+{
+  GSoundPlayInfo info = { NULL, };
+  gboolean valid;
+  ca_proplist *pl;
+  va_list args;
+  int res;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  if ((res = gsound_context_create_proplist (self, &pl)) != CA_SUCCESS)
+    return test_return (res, error);
+
+  va_start (args, error);
+  valid = var_args_to_prop_list (args, pl, &info, error);
+  va_end (args);
+
+  if (!valid)
+    {
+      ca_proplist_destroy (pl);
+      return FALSE;
+    }
+
+  return gsound_context_play_proplist (self, pl, NULL, &info,
+                                       cancellable, error);
+}
+
+/**
+ * gsound_context_play_simple_ids: (skip)
+ * @context: A #GSoundContext
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @error: Return location for error, or %NULL
+ * @...: A list of #GSoundAttrId and value pairs, terminated by
+ *   %GSOUND_ATTR_ID_INVALID
+ *
+ * Exactly like gsound_context_play_simple(), but the attributes are given
+ * by #GSoundAttrId rather than by name, which saves GSound from comparing
+ * the names with those it needs to know about.
+ *
+ * Returns: %TRUE on success, or %FALSE, populating @error
+ */
+gboolean
+gsound_context_play_simple_ids (GSoundContext *self,
+                                GCancellable  *cancellable,
+                                GError       **error,
+                                ...)
+{
+  GSoundPlayInfo info = { NULL, };
+  gboolean valid;
+  ca_proplist *pl;
+  va_list args;
+  int res;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  if ((res = gsound_context_create_proplist (self, &pl)) != CA_SUCCESS)
+    return test_return (res, error);
+
+  va_start (args, error);
+  valid = var_args_ids_to_prop_list (args, pl, &info, error);
+  va_end (args);
+
+  if (!valid)
+    {
+      ca_proplist_destroy (pl);
+      return FALSE;
+    }
+
+  return gsound_context_play_proplist (self, pl, NULL, &info,
+                                       cancellable, error);
+}
+
+/**
+ * gsound_context_play_simplev: (rename-to gsound_context_play_simple)
+ * @context: A #GSoundContext
+ * @attrs: (element-type utf8 utf8): Attributes
+ * @cancellable: (allow-none): A #GCancellable
+ * @error: Return location for error
+ *
+ * The basic "fire-and-forget" play command. This function will not block, and
+ * just sends a request to the sound server before immediately returning.
+ *
+ * If you need to know when a sound finishes playing then you should call
+ * gsound_context_play_full() instead.
+ *
+ * You can cancel playback at any time by calling g_cancellable_cancel() on
+ * @cancellable, if supplied.
+ * 
+ * This function is intented to be used by language bindings.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ *
+ */
+gboolean
+gsound_context_play_simplev (GSoundContext *self,
+                             GHashTable    *attrs,
+                             GCancellable  *cancellable,
+                             GError       **error)
+{
+  GSoundPlayInfo info;
+  ca_proplist *pl;
+  int res = gsound_context_create_proplist (self, &pl);
+
+  if (!test_return (res, error))
+    return FALSE;
+
+  if (!hash_table_to_prop_list (attrs, pl, error))
+    {
+      ca_proplist_destroy (pl);
+      return FALSE;
+    }
+
+  gsound_play_info_from_hash_table (&info, attrs);
+
+  return gsound_context_play_proplist (self, pl, NULL, &info,
+                                       cancellable, error);
+}
+
+/**
+ * gsound_context_play_full: (skip)
+ * @context: A #GSoundContext
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @callback: (scope async): callback
+ * @user_data: User data passed to @callback
+ * @...: A %NULL-terminated list of attribute-value pairs
+ *
+ * Asynchronously request a sound to be played. When playback is finished
+ * (or if an error occurs) then @callback will be called, following the
+ * normal GIO async pattern.
+ *
+ * If playback is cancelled via @cancellable, then @callback will be called
+ * with #G_IO_ERROR_CANCELLED.
+ *
+ * If you do not need notification of when playback is complete, you should
+ * use gsound_context_play_simple().
+ */
+void
+gsound_context_play_full (GSoundContext      *self,
+                          GCancellable       *cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer            user_data,
+                          ...)
+{
+  GSoundPlayInfo info = { NULL, };
+  GError *inner_error = NULL;
+  ca_proplist *proplist;
+  gboolean valid;
+  va_list args;
+  GSoundResult *task;
+  int res;
+
+  task = gsound_context_new_result (self, cancellable, callback, user_data);
+
+  res = gsound_context_create_proplist (self, &proplist);
+  if (!test_return (res, &inner_error))
+    {
+      _gsound_result_return_error (task, inner_error);
+      g_object_unref (task);
+      return;
+    }
+
+  va_start (args, user_data);
+  valid = var_args_to_prop_list (args, proplist, &info, &inner_error);
+  va_end (args);
+
+  if (!valid)
+    {
+      ca_proplist_destroy (proplist);
+      _gsound_result_return_error (task, inner_error);
+      g_object_unref (task);
+      return;
+    }
+
+  gsound_context_queue_play (self, task, proplist, NULL, &info);
+}
+
+/**
+ * gsound_context_play_fullv: (rename-to gsound_context_play_full)
+ * @context: A #GSoundContext
+ * @attrs: (element-type utf8 utf8): Attributes
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @callback: (scope async): callback
+ * @user_data: user_data
+ *
+ * Asynchronously request a sound to be played. When playback is finished
+ * (or if an error occurs) then @callback will be called, following the
+ * normal GIO async pattern.
+ *
+ * If playback is cancelled via @cancellable, then @callback will be called
+ * with #G_IO_ERROR_CANCELLED.
+ *
+ * If you do not need notification of when playback is complete, you should
+ * use gsound_context_play_simple().
+ * 
+ * This function is intented to be used by language bindings.
+ */
+void
+gsound_context_play_fullv (GSoundContext      *self,
+                           GHashTable         *attrs,
+                           GCancellable       *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer            user_data)
+{
+  GError *inner_error = NULL;
+  GSoundPlayInfo info;
+  ca_proplist *proplist;
+  GSoundResult *task;
+  int res;
+
+  task = gsound_context_new_result (self, cancellable, callback, user_data);
+
+  res = gsound_context_create_proplist (self, &proplist);
+  if (!test_return (res, &inner_error))
+    {
+      _gsound_result_return_error (task, inner_error);
+      g_object_unref (task);
+      return;
+    }
+
+  if (!hash_table_to_prop_list (attrs, proplist, &inner_error))
+    {
+      ca_proplist_destroy (proplist);
+      _gsound_result_return_error (task, inner_error);
+      g_object_unref (task);
+      return;
+    }
+
+  gsound_play_info_from_hash_table (&info, attrs);
+
+  gsound_context_queue_play (self, task, proplist, NULL, &info);
+}
+
+/**
+ * gsound_context_play_full_finish:
+ * @context: A #GSoundContext
+ * @result: Result object passed to the callback of
+ *   gsound_context_play_full()
+ * @error: Return location for error
+ *
+ * Finish an async operation started by gsound_context_play_full(). You
+ * must call this function in the callback to free memory and receive any
+ * errors which occurred.
+ *
+ * Returns: %TRUE if playing finished successfully
+ */
+gboolean
+gsound_context_play_full_finish (GSoundContext *self,
+                                 GAsyncResult  *result,
+                                 GError       **error)
+{
+  g_return_val_if_fail (_gsound_result_is_valid (result, self), FALSE);
+
+  return _gsound_result_propagate_boolean (GSOUND_RESULT (result), error);
+}
+
+/**
+ * gsound_context_play_attrs:
+ * @context: A #GSoundContext
+ * @attrs: A #GSoundAttributes
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @error: Return location for error, or %NULL
+ *
+ * The "fire-and-forget" play command, using a prebuilt set of attributes.
+ * This behaves exactly like gsound_context_play_simple() but avoids
+ * converting the attributes for every call, so it is the preferred way
+ * to play the same sound many times.
+ *
+ * Returns: %TRUE on success, or %FALSE, populating @error
+ */
+gboolean
+gsound_context_play_attrs (GSoundContext    *self,
+                           GSoundAttributes *attrs,
+                           GCancellable     *cancellable,
+                           GError          **error)
+{
   g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+  g_return_val_if_fail (attrs != NULL, FALSE);
+
+  return gsound_context_play_proplist (self, NULL, attrs, NULL,
+                                       cancellable, error);
+}
+
+/**
+ * gsound_context_play_attrs_with_handle:
+ * @context: A #GSoundContext
+ * @attrs: A #GSoundAttributes
+ * @error: Return location for error, or %NULL
+ *
+ * Plays a sound like gsound_context_play_attrs(), and returns a handle on
+ * it. The handle can stop the sound, say whether it is still playing, and
+ * emits #GSoundPlayback::finished when it is done, so there is no need for
+ * a #GCancellable or callback for each sound.
+ *
+ * Returns: (transfer full) (nullable): A handle on the sound, or %NULL,
+ *   populating @error
+ */
+GSoundPlayback *
+gsound_context_play_attrs_with_handle (GSoundContext    *self,
+                                       GSoundAttributes *attrs,
+                                       GError          **error)
+{
+  GSoundPlayback *playback;
+  GSoundPlayInfo info;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), NULL);
+  g_return_val_if_fail (attrs != NULL, NULL);
+
+  playback = _gsound_playback_new (self, self->main_context);
+
+  gsound_play_info_from_attrs (&info, attrs);
+  info.playback = playback;
+
+  if (!gsound_context_play_proplist (self, NULL, attrs, &info, NULL, error))
+    g_clear_object (&playback);
+
+  return playback;
+}
+
+/**
+ * gsound_context_get_playing:
+ * @context: A #GSoundContext
+ * @playbacks: (array length=n_playbacks): The handles to ask about, all
+ *   from @context
+ * @n_playbacks: The number of handles in @playbacks
+ * @playing: (out caller-allocates) (array length=n_playbacks) (allow-none):
+ *   Return location for whether each handle is still playing, or %NULL
+ *
+ * Finds out which of @playbacks are still playing, in one call. Unlike
+ * gsound_playback_is_playing(), this never asks the sound server: it looks
+ * at the context's own record of the sounds it has started, which is kept
+ * up to date as they finish, so polling is cheap however many sounds you
+ * ask about.
+ *
+ * A sound counts as playing from when it is started until it finishes or
+ * is stopped.
+ *
+ * Returns: The number of @playbacks which are still playing
+ */
+guint
+gsound_context_get_playing (GSoundContext         *self,
+                            GSoundPlayback * const *playbacks,
+                            guint                  n_playbacks,
+                            gboolean              *playing)
+{
+  guint i, n_playing = 0;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), 0);
+  g_return_val_if_fail (playbacks != NULL || n_playbacks == 0, 0);
+
+  g_rec_mutex_lock (&self->lock);
+
+  for (i = 0; i < n_playbacks; i++)
+    {
+      guint32 id = _gsound_playback_get_id (playbacks[i]);
+      GSoundPlay *play = NULL;
+
+      if (_gsound_playback_get_context (playbacks[i]) == self)
+        play = g_hash_table_lookup (self->plays, GUINT_TO_POINTER (id));
+
+      if (playing)
+        playing[i] = play && !play->cancelled;
+      if (play && !play->cancelled)
+        n_playing++;
+    }
+
+  g_rec_mutex_unlock (&self->lock);
+
+  return n_playing;
+}
+
+/**
+ * gsound_context_is_playing:
+ * @context: A #GSoundContext
+ * @playback: A #GSoundPlayback from @context
+ *
+ * Finds out whether @playback is still playing, without asking the sound
+ * server. See gsound_context_get_playing().
+ *
+ * Returns: %TRUE if the sound is still playing
+ */
+gboolean
+gsound_context_is_playing (GSoundContext  *self,
+                           GSoundPlayback *playback)
+{
+  g_return_val_if_fail (GSOUND_IS_PLAYBACK (playback), FALSE);
+
+  return gsound_context_get_playing (self, &playback, 1, NULL) == 1;
+}
+
+/* Stops the play @id, for gsound_playback_stop() */
+void
+_gsound_context_stop_play (GSoundContext *self,
+                           guint32        id)
+{
+  gboolean submitted = FALSE;
+  GSoundPlay *play;
+
+  g_rec_mutex_lock (&self->lock);
+  play = g_hash_table_lookup (self->plays, GUINT_TO_POINTER (id));
+  if (play)
+    {
+      /* A play still in the queue will notice this before submission */
+      play->cancelled = TRUE;
+      submitted = play->submitted;
+    }
+  g_rec_mutex_unlock (&self->lock);
+
+  if (submitted)
+    gsound_context_backend_cancel (self, id);
+}
+
+/*
+ * Whether the play @id is waiting to be submitted or playing, for
+ * gsound_playback_is_playing()
+ */
+gboolean
+_gsound_context_is_play_active (GSoundContext *self,
+                                guint32        id)
+{
+  gboolean submitted = FALSE;
+  int playing = FALSE;
+  GSoundPlay *play;
+
+  g_rec_mutex_lock (&self->lock);
+  play = g_hash_table_lookup (self->plays, GUINT_TO_POINTER (id));
+  if (play)
+    {
+      submitted = play->submitted;
+      playing = !play->cancelled;
+    }
+  g_rec_mutex_unlock (&self->lock);
+
+  if (submitted &&
+      gsound_context_backend_playing (self, id, &playing) != CA_SUCCESS)
+    playing = FALSE;
+
+  return playing;
+}
+
+/**
+ * gsound_context_play_attrs_full:
+ * @context: A #GSoundContext
+ * @attrs: A #GSoundAttributes
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @callback: (scope async): callback
+ * @user_data: User data passed to @callback
+ *
+ * Asynchronously request a sound to be played using a prebuilt set of
+ * attributes. This behaves exactly like gsound_context_play_full(); call
+ * gsound_context_play_full_finish() from @callback to receive the result.
+ */
+void
+gsound_context_play_attrs_full (GSoundContext      *self,
+                                GSoundAttributes   *attrs,
+                                GCancellable       *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer            user_data)
+{
+  GSoundResult *task;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (attrs != NULL);
+
+  task = gsound_context_new_result (self, cancellable, callback, user_data);
+
+  gsound_context_queue_play (self, task, NULL, attrs, NULL);
+}
+
+/**
+ * gsound_context_play_batch:
+ * @context: A #GSoundContext
+ * @attrs: (array length=n_attrs): The sounds to play
+ * @n_attrs: The number of elements in @attrs
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @callback: (scope async): callback
+ * @user_data: User data passed to @callback
+ *
+ * Asynchronously requests that several sounds be played at once. This is
+ * cheaper than calling gsound_context_play_attrs_full() for each sound,
+ * since all of the sounds are submitted together and share a single
+ * result and a single connection to @cancellable.
+ *
+ * @callback will be called once, when every sound has finished playing
+ * (or failed). Call gsound_context_play_batch_finish() from @callback to
+ * find out what happened to each sound.
+ *
+ * Cancelling @cancellable stops all of the sounds in the batch.
+ */
+void
+gsound_context_play_batch (GSoundContext       *self,
+                           GSoundAttributes   **attrs,
+                           guint                n_attrs,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+  GSoundJob *newest = NULL, *oldest = NULL;
+  GSoundBatch *batch;
+  GSoundResult *task;
+  guint i;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (attrs != NULL || n_attrs == 0);
+
+  task = gsound_context_new_result (self, cancellable, callback, user_data);
+  _gsound_result_set_source_tag (task, gsound_context_play_batch);
+
+  if (_gsound_result_return_error_if_cancelled (task))
+    {
+      g_object_unref (task);
+      return;
+    }
+
+  if (n_attrs == 0)
+    {
+      _gsound_result_return_pointer (task,
+                                     g_ptr_array_new_with_free_func (clear_error_func),
+                                     (GDestroyNotify) g_ptr_array_unref);
+      g_object_unref (task);
+      return;
+    }
+
+  gsound_context_ensure_connection (self);
+
+  batch = g_slice_new0 (GSoundBatch);
+  batch->task = task;
+  batch->remaining = n_attrs;
+  batch->errors = g_ptr_array_new_full (n_attrs, clear_error_func);
+  g_ptr_array_set_size (batch->errors, n_attrs);
+
+  for (i = 0; i < n_attrs; i++)
+    {
+      GSoundAttributes *item_attrs = attrs[i];
+      ca_proplist *item_proplist = NULL;
+      GSoundAdmission admission;
+      GSoundPlayInfo info;
+      GSoundPlay *play;
+      int res;
+
+      gsound_play_info_from_attrs (&info, item_attrs);
+      gsound_context_scope_info (self, &info);
+
+      /* This may complete the batch, but only if nothing is queued */
+      res = gsound_context_scope_attrs (self, &item_proplist, &item_attrs);
+      if (res != CA_SUCCESS)
+        {
+          gsound_batch_item_complete (batch, i,
+                                      g_error_new_literal (GSOUND_ERROR, res,
+                                                           ca_strerror (res)));
+          continue;
+        }
+
+      gsound_context_touch_sample (self, info.event_id);
+
+      admission = gsound_context_admit (self, info.event_id);
+      if (admission == ADMIT_MERGE || admission == ADMIT_DROP)
+        {
+          GError *item_error;
+
+          item_error = gsound_admission_error (admission, info.event_id);
+          g_clear_pointer (&item_proplist, ca_proplist_destroy);
+          gsound_batch_item_complete (batch, i, item_error);
+          continue;
+        }
+
+      play = gsound_play_new (self, cancellable, NULL);
+      play->job.run = gsound_play_run;
+      play->batch = batch;
+      play->batch_index = i;
+      play->proplist = item_proplist;
+      play->attrs = item_attrs;
+      gsound_context_resolve_event (self, &info, &play->proplist,
+                                    &play->attrs);
+      if (play->attrs)
+        gsound_attributes_ref (play->attrs);
+      gsound_play_set_info (play, admission, &info, attrs[i]);
+
+      play->job.next = newest;
+      newest = &play->job;
+      if (!oldest)
+        oldest = newest;
+    }
+
+  if (newest)
+    gsound_context_push_jobs (self, newest, oldest);
+}
+
+/**
+ * gsound_context_play_batch_finish:
+ * @context: A #GSoundContext
+ * @result: Result object passed to the callback of
+ *   gsound_context_play_batch()
+ * @errors: (out) (optional) (transfer container) (element-type GLib.Error):
+ *   Return location for the error of each sound, in the order they were
+ *   given, with %NULL for those which played successfully
+ * @error: Return location for error
+ *
+ * Finish an async operation started by gsound_context_play_batch().
+ *
+ * Returns: %TRUE if every sound played successfully. Otherwise %FALSE,
+ *          and @error is set to the first error which occurred
+ */
+gboolean
+gsound_context_play_batch_finish (GSoundContext  *self,
+                                  GAsyncResult   *result,
+                                  GPtrArray     **errors,
+                                  GError        **error)
+{
+  GPtrArray *item_errors;
+  gboolean success = TRUE;
+  guint i;
 
-  if ((res = ca_proplist_create (&pl)) != CA_SUCCESS)
-    return test_return (res, error);
+  g_return_val_if_fail (_gsound_result_is_valid (result, self), FALSE);
 
-  va_start (args, error);
-  var_args_to_prop_list (args, pl);
-  va_end (args);
+  item_errors = _gsound_result_propagate_pointer (GSOUND_RESULT (result), error);
+  if (!item_errors)
+    return FALSE;
 
-  res = ca_context_change_props_full (self->ca, pl);
+  for (i = 0; i < item_errors->len && success; i++)
+    {
+      GError *item_error = g_ptr_array_index (item_errors, i);
 
-  g_clear_pointer (&pl, ca_proplist_destroy);
+      if (item_error)
+        {
+          g_propagate_error (error, g_error_copy (item_error));
+          success = FALSE;
+        }
+    }
 
-  return test_return (res, error);
+  if (errors)
+    *errors = item_errors;
+  else
+    g_ptr_array_unref (item_errors);
+
+  return success;
+}
+
+/*
+ * Makes a property list for playing or caching the sound in @file. The
+ * attributes in @attrs, if given, are added too. On failure, @file is
+ * unreffed.
+ */
+static ca_proplist *
+gsound_context_sample_to_proplist (GSoundContext     *self,
+                                   GSoundSampleFile  *file,
+                                   GSoundAttributes  *attrs,
+                                   GError           **error)
+{
+  ca_proplist *pl = NULL;
+  int res;
+
+  res = gsound_context_create_proplist (self, &pl);
+  if (res == CA_SUCCESS && attrs)
+    res = _gsound_attributes_copy_to_proplist (attrs, pl);
+  if (res == CA_SUCCESS)
+    res = ca_proplist_sets (pl, CA_PROP_MEDIA_FILENAME,
+                            _gsound_sample_file_get_path (file));
+
+  if (res != CA_SUCCESS)
+    {
+      if (pl)
+        ca_proplist_destroy (pl);
+      _gsound_sample_file_unref (file);
+      test_return (res, error);
+      return NULL;
+    }
+
+  return pl;
+}
+
+/*
+ * Makes a property list for playing or caching @bytes, which is stored in
+ * a new sample file. The attributes in @attrs, if given, are added too.
+ */
+static ca_proplist *
+gsound_context_bytes_to_proplist (GSoundContext           *self,
+                                  GBytes                  *bytes,
+                                  const GSoundSampleSpec  *spec,
+                                  GSoundAttributes        *attrs,
+                                  GSoundSampleFile       **file,
+                                  GError                 **error)
+{
+  ca_proplist *pl;
+
+  *file = _gsound_sample_file_new (bytes, spec, error);
+  if (!*file)
+    return NULL;
+
+  pl = gsound_context_sample_to_proplist (self, *file, attrs, error);
+  if (!pl)
+    *file = NULL;
+
+  return pl;
 }
 
 /**
- * gsound_context_set_attributesv: (rename-to gsound_context_set_attributes)
+ * gsound_context_play_bytes:
  * @context: A #GSoundContext
- * @attrs: (element-type utf8 utf8): Hash table of attributes to set
+ * @bytes: The sound to play
+ * @spec: (allow-none): The format of @bytes, or %NULL if @bytes holds a
+ *   complete sound file (such as a WAV or Ogg Vorbis file)
+ * @attrs: (allow-none): Other attributes of the sound, or %NULL
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
  * @error: Return location for error, or %NULL
  *
- * Set attributes or change attributes on @context. Subsequent calls to this
- * function calling the same attributes will override the earlier values.
+ * The "fire-and-forget" play command for a sound which is held in memory,
+ * rather than in a file or sound theme. Otherwise this behaves exactly like
+ * gsound_context_play_attrs().
  *
- * Note that GSound will set the #GSOUND_ATTR_APPLICATION_NAME and
- * #GSOUND_ATTR_APPLICATION_ID for you if using #GApplication, so you do
- * not normally need to set these yourself.
- * 
- * This function is intented to be used by language bindings.
+ * If @spec is given, @bytes is raw PCM audio in that format.
  *
- * Returns: %TRUE if attributes were updated successfully
+ * The data is copied once into an anonymous in-memory file, which is
+ * handed to the sound server, so nothing is written to disk. Bytes from a
+ * #GMappedFile are copied in the same way; to play a sound which is
+ * already in a file, set #GSOUND_ATTR_MEDIA_FILENAME instead.
+ *
+ * Returns: %TRUE on success, or %FALSE, populating @error
  */
 gboolean
-gsound_context_set_attributesv (GSoundContext *self,
-                                GHashTable    *attrs,
-                                GError       **error)
+gsound_context_play_bytes (GSoundContext          *self,
+                           GBytes                 *bytes,
+                           const GSoundSampleSpec *spec,
+                           GSoundAttributes       *attrs,
+                           GCancellable           *cancellable,
+                           GError                **error)
 {
+  GSoundPlayInfo info = { NULL, };
+  GSoundSampleFile *file;
+  gboolean success;
   ca_proplist *pl;
-  int res;
 
   g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+  g_return_val_if_fail (bytes != NULL, FALSE);
 
-  res = ca_proplist_create (&pl);
-  if (!test_return (res, error))
+  pl = gsound_context_bytes_to_proplist (self, bytes, spec, attrs, &file,
+                                         error);
+  if (!pl)
     return FALSE;
 
-  hash_table_to_prop_list (attrs, pl);
+  if (attrs)
+    gsound_play_info_from_attrs (&info, attrs);
+  info.sample = file;
 
-  res = ca_context_change_props_full (self->ca, pl);
+  success = gsound_context_play_proplist (self, pl, NULL, &info,
+                                          cancellable, error);
+  _gsound_sample_file_unref (file);
 
-  g_clear_pointer (&pl, ca_proplist_destroy);
+  return success;
+}
 
-  return test_return (res, error);
+/**
+ * gsound_context_play_bytes_full:
+ * @context: A #GSoundContext
+ * @bytes: The sound to play
+ * @spec: (allow-none): The format of @bytes, or %NULL if @bytes holds a
+ *   complete sound file
+ * @attrs: (allow-none): Other attributes of the sound, or %NULL
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @callback: (scope async): callback
+ * @user_data: User data passed to @callback
+ *
+ * Asynchronously plays a sound which is held in memory. See
+ * gsound_context_play_bytes() for details. Call
+ * gsound_context_play_full_finish() from @callback to receive the result.
+ */
+void
+gsound_context_play_bytes_full (GSoundContext          *self,
+                                GBytes                 *bytes,
+                                const GSoundSampleSpec *spec,
+                                GSoundAttributes       *attrs,
+                                GCancellable           *cancellable,
+                                GAsyncReadyCallback     callback,
+                                gpointer                user_data)
+{
+  GSoundPlayInfo info = { NULL, };
+  GError *inner_error = NULL;
+  GSoundSampleFile *file;
+  ca_proplist *pl;
+  GSoundResult *task;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (bytes != NULL);
+
+  task = gsound_context_new_result (self, cancellable, callback, user_data);
+
+  pl = gsound_context_bytes_to_proplist (self, bytes, spec, attrs, &file,
+                                         &inner_error);
+  if (!pl)
+    {
+      _gsound_result_return_error (task, inner_error);
+      g_object_unref (task);
+      return;
+    }
+
+  if (attrs)
+    gsound_play_info_from_attrs (&info, attrs);
+  info.sample = file;
+
+  gsound_context_queue_play (self, task, pl, NULL, &info);
+  _gsound_sample_file_unref (file);
+}
+
+/* A gsound_context_play_stream() waiting for the start of its stream */
+typedef struct
+{
+  GSoundContext    *context;
+  GSoundResult     *task;
+  GSoundAttributes *attrs;
+} GSoundStreamStart;
+
+static void
+on_play_stream_ready (GObject      *source,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+  GSoundStreamStart *start = user_data;
+  GSoundContext *self = start->context;
+  GSoundResult *task = start->task;
+  GSoundPlayInfo info = { NULL, };
+  GError *inner_error = NULL;
+  GSoundSampleFile *file;
+  ca_proplist *pl = NULL;
+  int res;
+
+  file = _gsound_sample_file_new_for_stream_finish (G_INPUT_STREAM (source),
+                                                    result, &inner_error);
+  if (file)
+    pl = gsound_context_sample_to_proplist (self, file, start->attrs,
+                                            &inner_error);
+
+  /* Uploading the sound to the cache first would mean reading all of it */
+  if (pl)
+    {
+      res = ca_proplist_sets (pl, CA_PROP_CANBERRA_CACHE_CONTROL, "never");
+      if (!test_return (res, &inner_error))
+        g_clear_pointer (&pl, ca_proplist_destroy);
+    }
+
+  if (pl)
+    {
+      if (start->attrs)
+        gsound_play_info_from_attrs (&info, start->attrs);
+      info.sample = file;
+
+      gsound_context_queue_play (self, task, pl, NULL, &info);
+    }
+  else
+    {
+      _gsound_result_return_error (task, inner_error);
+      g_object_unref (task);
+    }
+
+  if (file)
+    _gsound_sample_file_unref (file);
+  if (start->attrs)
+    gsound_attributes_unref (start->attrs);
+  g_object_unref (self);
+  g_slice_free (GSoundStreamStart, start);
 }
 
 /**
- * gsound_context_play_simple: (skip)
+ * gsound_context_play_stream:
  * @context: A #GSoundContext
+ * @stream: The sound to play
+ * @attrs: (allow-none): Other attributes of the sound, or %NULL
  * @cancellable: (allow-none): A #GCancellable, or %NULL
- * @error: Return location for error, or %NULL
- * @...: A %NULL-terminated list of attribute-value pairs
+ * @callback: (scope async): callback
+ * @user_data: User data passed to @callback
  *
- * The basic "fire-and-forget" play command. This function will not block, and
- * just sends a request to the sound server before immediately returning.
+ * Asynchronously plays a sound which is read from @stream as it plays,
+ * rather than being loaded in full first. This is the best way to play long
+ * sounds such as voice prompts or music, or sounds arriving over the
+ * network, as only a small, fixed amount of the sound is buffered at a time
+ * and playback can begin as soon as the first data arrives.
  *
- * If you need to know when a sound finishes playing then you should call
- * gsound_context_play_full() instead.
+ * @stream must hold a complete sound file in a format which can be read
+ * from start to finish without seeking, such as a WAV file. It is read
+ * asynchronously in the thread-default main context of the caller, which
+ * must be running for playback to continue.
  *
- * You can cancel playback at any time by calling g_cancellable_cancel() on
- * @cancellable, if supplied. 
+ * The sound is only queued once the start of @stream has been read, so a
+ * slow stream doesn't hold up other sounds played on @context while the
+ * sound server reads its header. If @stream stalls after that, the sound
+ * simply stalls with it.
  *
- * Returns: %TRUE on success, or %FALSE, populating @error
+ * Cancelling @cancellable stops both the sound and the reading of @stream,
+ * including while waiting for the start of it. Call
+ * gsound_context_play_full_finish() from @callback to receive the result.
+ * @stream is not closed.
+ */
+void
+gsound_context_play_stream (GSoundContext       *self,
+                            GInputStream        *stream,
+                            GSoundAttributes    *attrs,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+  GSoundStreamStart *start;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (G_IS_INPUT_STREAM (stream));
+
+  start = g_slice_new (GSoundStreamStart);
+  start->context = g_object_ref (self);
+  start->task = gsound_context_new_result (self, cancellable, callback,
+                                           user_data);
+  start->attrs = attrs ? gsound_attributes_ref (attrs) : NULL;
+
+  /* The sound is only queued once its header has arrived */
+  _gsound_sample_file_new_for_stream_async (stream, cancellable,
+                                            on_play_stream_ready, start);
+}
+
+/**
+ * gsound_context_cache_bytes:
+ * @context: A #GSoundContext
+ * @event_id: The event ID to cache the sound as
+ * @bytes: The sound to cache
+ * @spec: (allow-none): The format of @bytes, or %NULL if @bytes holds a
+ *   complete sound file
+ * @error: Return location for error, or %NULL
+ *
+ * Uploads a sound which is held in memory to the sound server's cache,
+ * where it can then be played by passing @event_id as the
+ * #GSOUND_ATTR_EVENT_ID of a sound. See
+ * [#caching][gsound-GSound-Context#caching].
+ *
+ * Returns: %TRUE on success
  */
 gboolean
-gsound_context_play_simple (GSoundContext *self,
-                            GCancellable  *cancellable,
-                            GError       **error,
-                            ...)
+gsound_context_cache_bytes (GSoundContext          *self,
+                            const char             *event_id,
+                            GBytes                 *bytes,
+                            const GSoundSampleSpec *spec,
+                            GError                **error)
 {
+  GSoundSampleFile *file;
   ca_proplist *pl;
-  va_list args;
   int res;
 
   g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+  g_return_val_if_fail (event_id != NULL, FALSE);
+  g_return_val_if_fail (bytes != NULL, FALSE);
 
-  if ((res = ca_proplist_create (&pl)) != CA_SUCCESS)
-    return test_return (res, error);
-
-  va_start (args, error);
-  var_args_to_prop_list (args, pl);
-  va_end (args);
+  pl = gsound_context_bytes_to_proplist (self, bytes, spec, NULL, &file,
+                                         error);
+  if (!pl)
+    return FALSE;
 
-  res = ca_context_play_full (self->ca,
-                              g_direct_hash (cancellable),
-                              pl, NULL, NULL);
+  res = ca_proplist_sets (pl, CA_PROP_EVENT_ID, event_id);
+  if (res == CA_SUCCESS)
+    res = gsound_context_backend_cache (self, pl);
 
-  if (cancellable)
-    g_cancellable_connect (cancellable,
-                           G_CALLBACK (on_cancellable_cancelled),
-                           g_object_ref (self),
-                           g_object_unref);
+  /* The sound has been uploaded by now, so we can let go of the file */
+  ca_proplist_destroy (pl);
+  _gsound_sample_file_unref (file);
 
-  g_clear_pointer (&pl, ca_proplist_destroy);
+  if (res == CA_SUCCESS)
+    _gsound_cache_index_insert (self->cache_index, event_id,
+                                g_bytes_get_size (bytes));
 
   return test_return (res, error);
 }
 
 /**
- * gsound_context_play_simplev: (rename-to gsound_context_play_simple)
+ * gsound_context_cache_bank:
  * @context: A #GSoundContext
- * @attrs: (element-type utf8 utf8): Attributes
- * @cancellable: (allow-none): A #GCancellable
- * @error: Return location for error
+ * @filename: (type filename): The sample bank to load
+ * @error: Return location for error, or %NULL
  *
- * The basic "fire-and-forget" play command. This function will not block, and
- * just sends a request to the sound server before immediately returning.
+ * Uploads every sound in the sample bank @filename to the sound server's
+ * cache, under the event IDs recorded in the bank.
  *
- * If you need to know when a sound finishes playing then you should call
- * gsound_context_play_full() instead.
+ * A sample bank holds many sounds which have already been decoded to PCM,
+ * and is made with the gsound-make-bank tool, for example from the sounds
+ * of a theme. Nothing needs to be decoded, so this is the quickest way to
+ * cache a large number of sounds at startup. Each sound is still copied
+ * into an anonymous in-memory file to be handed to the sound server, as
+ * with gsound_context_cache_bytes().
  *
- * You can cancel playback at any time by calling g_cancellable_cancel() on
- * @cancellable, if supplied.
+ * If a sound fails to upload, the remaining sounds are not cached.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gsound_context_cache_bank (GSoundContext  *self,
+                           const char     *filename,
+                           GError        **error)
+{
+  gboolean success = TRUE;
+  GSoundBank *bank;
+  guint i, n;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  bank = _gsound_bank_open (filename, error);
+  if (!bank)
+    return FALSE;
+
+  n = _gsound_bank_get_n_entries (bank);
+  for (i = 0; i < n && success; i++)
+    {
+      GSoundSampleSpec spec;
+      const char *event_id;
+      GBytes *bytes;
+
+      bytes = _gsound_bank_get_entry (bank, i, &event_id, &spec);
+      success = gsound_context_cache_bytes (self, event_id, bytes,
+                                            &spec, error);
+      g_bytes_unref (bytes);
+    }
+
+  _gsound_bank_free (bank);
+
+  return success;
+}
+
+/**
+ * gsound_context_cache: (skip)
+ * @context: A #GSoundContext
+ * @error: Return location for error
+ * @...: A %NULL-terminated list of attribute-value pairs
+ *
+ * Requests that a sound be cached on the server. See [#caching][gsound-GSound-Context#caching].
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gsound_context_cache (GSoundContext *self,
+                      GError       **error,
+                      ...)
+{
+  GSoundAttributes *attrs;
+  gboolean success;
+  va_list args;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  va_start (args, error);
+  attrs = _gsound_attributes_new_valist (error, args);
+  va_end (args);
+
+  if (!attrs)
+    return FALSE;
+
+  success = gsound_context_cache_attrs (self, attrs, error);
+  gsound_attributes_unref (attrs);
+
+  return success;
+}
+
+/**
+ * gsound_context_cachev: (rename-to gsound_context_cache)
+ * @context: A #GSoundContext
+ * @attrs: (element-type utf8 utf8): Hash table of attrerties
+ * @error: Return location for error, or %NULL
  * 
+ * Requests that a sound be cached on the server. See [#caching][gsound-GSound-Context#caching].
+ *
  * This function is intented to be used by language bindings.
+ */
+gboolean
+gsound_context_cachev (GSoundContext *self,
+                       GHashTable    *attrs,
+                       GError       **error)
+{
+  GSoundAttributes *item;
+  gboolean success;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+
+  item = gsound_attributes_newv (attrs, error);
+  if (!item)
+    return FALSE;
+
+  success = gsound_context_cache_attrs (self, item, error);
+  gsound_attributes_unref (item);
+
+  return success;
+}
+
+/**
+ * gsound_context_cache_attrs:
+ * @context: A #GSoundContext
+ * @attrs: A #GSoundAttributes
+ * @error: Return location for error, or %NULL
  *
- * Returns: %TRUE on success, %FALSE on error
+ * Requests that a sound be cached on the server, using a prebuilt set of
+ * attributes. See [#caching][gsound-GSound-Context#caching].
  *
+ * Returns: %TRUE on success
+ */
+gboolean
+gsound_context_cache_attrs (GSoundContext    *self,
+                            GSoundAttributes *attrs,
+                            GError          **error)
+{
+  int res;
+
+  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+  g_return_val_if_fail (attrs != NULL, FALSE);
+
+  res = gsound_context_backend_cache (self,
+                                      _gsound_attributes_get_proplist (attrs));
+  if (res == CA_SUCCESS)
+    gsound_context_index_sample (self, attrs);
+
+  return test_return (res, error);
+}
+
+typedef struct
+{
+  GPtrArray                  *attrs;
+
+  GError                     *error;
+  guint                       n_failed;
+
+  GSoundCacheProgressCallback progress_callback;
+  gpointer                    progress_data;
+  GDestroyNotify              progress_notify;
+} GSoundCacheOp;
+
+typedef struct
+{
+  GTask *task;
+  guint  n_done;
+} GSoundCacheProgress;
+
+static void
+gsound_cache_op_free (gpointer data)
+{
+  GSoundCacheOp *op = data;
+
+  g_ptr_array_unref (op->attrs);
+  g_clear_error (&op->error);
+
+  if (op->progress_notify)
+    op->progress_notify (op->progress_data);
+
+  g_slice_free (GSoundCacheOp, op);
+}
+
+static gboolean
+cache_progress_idle (gpointer user_data)
+{
+  GSoundCacheProgress *progress = user_data;
+  GSoundCacheOp *op = g_task_get_task_data (progress->task);
+
+  op->progress_callback (g_task_get_source_object (progress->task),
+                         progress->n_done,
+                         op->attrs->len,
+                         op->progress_data);
+
+  g_object_unref (progress->task);
+  g_slice_free (GSoundCacheProgress, progress);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gsound_cache_op_finish (GTask *task)
+{
+  GSoundCacheOp *op = g_task_get_task_data (task);
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (op->error)
+    {
+      GError *error = op->error;
+
+      op->error = NULL;
+      g_prefix_error (&error, "Failed to cache %u of %u sounds: ",
+                      op->n_failed, op->attrs->len);
+      g_task_return_error (task, error);
+    }
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * Uploads the samples one after another. libcanberra serialises uploads on
+ * a context anyway, so a single thread is as quick as several, and keeps
+ * the caller and the play worker free.
  */
-gboolean
-gsound_context_play_simplev (GSoundContext *self,
-                             GHashTable    *attrs,
-                             GCancellable  *cancellable,
-                             GError       **error)
+static void
+cache_thread (GTask        *task,
+              gpointer      source_object,
+              gpointer      task_data,
+              GCancellable *cancellable)
 {
-  ca_proplist *pl;
-  int res = ca_proplist_create (&pl);
+  GSoundContext *self = source_object;
+  GSoundCacheOp *op = task_data;
+  guint i;
 
-  if (!test_return (res, error))
-    return FALSE;
+  for (i = 0; i < op->attrs->len && !g_cancellable_is_cancelled (cancellable);
+       i++)
+    {
+      GSoundAttributes *attrs;
+      int res;
 
-  hash_table_to_prop_list (attrs, pl);
+      attrs = g_ptr_array_index (op->attrs, i);
+      res = gsound_context_backend_cache (self,
+                                          _gsound_attributes_get_proplist (attrs));
 
-  res = ca_context_play_full (self->ca,
-                              g_direct_hash (cancellable),
-                              pl, NULL, NULL);
+      if (res == CA_SUCCESS)
+        {
+          gsound_context_set_connected (self);
+          gsound_context_index_sample (self, attrs);
+        }
+      else
+        {
+          if (!op->error)
+            op->error = g_error_new_literal (GSOUND_ERROR, res,
+                                             ca_strerror (res));
+          op->n_failed++;
+        }
 
-  if (cancellable)
-    g_cancellable_connect (cancellable,
-                           G_CALLBACK (on_cancellable_cancelled),
-                           g_object_ref (self),
-                           g_object_unref);
+      if (op->progress_callback)
+        {
+          GSoundCacheProgress *progress;
 
-  g_clear_pointer (&pl, ca_proplist_destroy);
+          progress = g_slice_new (GSoundCacheProgress);
+          progress->task = g_object_ref (task);
+          progress->n_done = i + 1;
 
-  return test_return (res, error);
+          g_main_context_invoke (g_task_get_context (task),
+                                 cache_progress_idle,
+                                 progress);
+        }
+    }
+
+  gsound_cache_op_finish (task);
+}
+
+/*
+ * Uploads @attrs (an array of #GSoundAttributes) in a helper thread.
+ * Takes ownership of @task and @attrs.
+ */
+static void
+gsound_context_cache_in_thread (GSoundContext              *self,
+                                GTask                      *task,
+                                GPtrArray                  *attrs,
+                                GSoundCacheProgressCallback progress_callback,
+                                gpointer                    progress_data,
+                                GDestroyNotify              progress_notify)
+{
+  GSoundCacheOp *op;
+
+  if (attrs->len == 0)
+    {
+      if (progress_notify)
+        progress_notify (progress_data);
+      g_ptr_array_unref (attrs);
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
+    }
+
+  op = g_slice_new0 (GSoundCacheOp);
+  op->attrs = attrs;
+  op->progress_callback = progress_callback;
+  op->progress_data = progress_data;
+  op->progress_notify = progress_notify;
+  g_task_set_task_data (task, op, gsound_cache_op_free);
+
+  g_task_run_in_thread (task, cache_thread);
+  g_object_unref (task);
 }
 
 /**
- * gsound_context_play_full: (skip)
+ * gsound_context_cache_async:
  * @context: A #GSoundContext
+ * @attrs: (array length=n_attrs): The sounds to cache
+ * @n_attrs: The number of elements in @attrs
  * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @progress_callback: (allow-none) (scope notified) (closure progress_data):
+ *   Function to call as each sound is uploaded, or %NULL
+ * @progress_data: User data passed to @progress_callback
+ * @progress_notify: (allow-none): Function to free @progress_data once
+ *   @progress_callback will not be called again, or %NULL
  * @callback: (scope async): callback
  * @user_data: User data passed to @callback
- * @...: A %NULL-terminated list of attribute-value pairs
  *
- * Asynchronously request a sound to be played. When playback is finished
- * (or if an error occurs) then @callback will be called, following the
- * normal GIO async pattern.
+ * Asynchronously requests that all of the sounds in @attrs be cached on
+ * the server. See [#caching][gsound-GSound-Context#caching].
  *
- * If playback is cancelled via @cancellable, then @callback will be called
- * with #G_IO_ERROR_CANCELLED.
+ * The sounds are uploaded one after another in a helper thread, so neither
+ * the caller nor sounds played on @context meanwhile are blocked. If given, @progress_callback is called in the thread-default
+ * main context of the caller each time a sound has been uploaded (whether
+ * successfully or not).
  *
- * If you do not need notification of when playback is complete, you should
- * use gsound_context_play_simple().
+ * Cancelling @cancellable stops any sounds which have not started
+ * uploading yet from being cached.
+ *
+ * When every sound has been dealt with, @callback will be called. Call
+ * gsound_context_cache_finish() to get the result.
  */
 void
-gsound_context_play_full (GSoundContext      *self,
-                          GCancellable       *cancellable,
-                          GAsyncReadyCallback callback,
-                          gpointer            user_data,
-                          ...)
+gsound_context_cache_async (GSoundContext               *self,
+                            GSoundAttributes           **attrs,
+                            guint                        n_attrs,
+                            GCancellable                *cancellable,
+                            GSoundCacheProgressCallback  progress_callback,
+                            gpointer                     progress_data,
+                            GDestroyNotify               progress_notify,
+                            GAsyncReadyCallback          callback,
+                            gpointer                     user_data)
 {
-  GError *inner_error = NULL;
-  ca_proplist *proplist;
-  va_list args;
+  GPtrArray *array;
   GTask *task;
-  int res;
-
-  task = g_task_new (self, cancellable, callback, user_data);
-
-  res = ca_proplist_create (&proplist);
-  if (!test_return (res, &inner_error))
-    {
-      g_task_return_error (task, inner_error);
-      g_object_unref (task);
-      return;
-    }
+  guint i;
 
-  va_start (args, user_data);
-  var_args_to_prop_list (args, proplist);
-  va_end (args);
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (attrs != NULL || n_attrs == 0);
 
-  res = ca_context_play_full (self->ca,
-                              g_direct_hash (cancellable),
-                              proplist,
-                              on_ca_play_full_finished,
-                              task);
-
-  if (cancellable)
-    g_cancellable_connect (cancellable,
-                           G_CALLBACK (on_cancellable_cancelled),
-                           g_object_ref (self),
-                           g_object_unref);
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gsound_context_cache_async);
 
-  g_clear_pointer (&proplist, ca_proplist_destroy);
+  array = g_ptr_array_new_full (n_attrs,
+                                (GDestroyNotify) gsound_attributes_unref);
+  for (i = 0; i < n_attrs; i++)
+    g_ptr_array_add (array, gsound_attributes_ref (attrs[i]));
 
-  if (!test_return (res, &inner_error))
-    {
-      g_task_return_error (task, inner_error);
-      g_object_unref (task);
-    }
+  gsound_context_cache_in_thread (self, task, array, progress_callback,
+                                  progress_data, progress_notify);
 }
 
 /**
- * gsound_context_play_fullv: (rename-to gsound_context_play_full)
+ * gsound_context_cachev_async:
  * @context: A #GSoundContext
- * @attrs: (element-type utf8 utf8): Attributes
+ * @attrs: (element-type GLib.HashTable): An array of hash tables of
+ *   attributes, one for each sound to cache
  * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @progress_callback: (allow-none) (scope notified) (closure progress_data):
+ *   Function to call as each sound is uploaded, or %NULL
+ * @progress_data: User data passed to @progress_callback
+ * @progress_notify: (allow-none): Function to free @progress_data once
+ *   @progress_callback will not be called again, or %NULL
  * @callback: (scope async): callback
- * @user_data: user_data
- *
- * Asynchronously request a sound to be played. When playback is finished
- * (or if an error occurs) then @callback will be called, following the
- * normal GIO async pattern.
+ * @user_data: User data passed to @callback
  *
- * If playback is cancelled via @cancellable, then @callback will be called
- * with #G_IO_ERROR_CANCELLED.
+ * Asynchronously requests that several sounds be cached on the server.
+ * See gsound_context_cache_async() for details.
  *
- * If you do not need notification of when playback is complete, you should
- * use gsound_context_play_simple().
- * 
  * This function is intented to be used by language bindings.
  */
 void
-gsound_context_play_fullv (GSoundContext      *self,
-                           GHashTable         *attrs,
-                           GCancellable       *cancellable,
-                           GAsyncReadyCallback callback,
-                           gpointer            user_data)
+gsound_context_cachev_async (GSoundContext               *self,
+                             GPtrArray                   *attrs,
+                             GCancellable                *cancellable,
+                             GSoundCacheProgressCallback  progress_callback,
+                             gpointer                     progress_data,
+                             GDestroyNotify               progress_notify,
+                             GAsyncReadyCallback          callback,
+                             gpointer                     user_data)
 {
-  GError *inner_error = NULL;
-  ca_proplist *proplist;
+  GError *error = NULL;
+  GPtrArray *array;
   GTask *task;
-  int res;
+  guint i;
+
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (attrs != NULL);
 
   task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gsound_context_cache_async);
 
-  res = ca_proplist_create (&proplist);
-  if (!test_return (res, &inner_error))
+  array = g_ptr_array_new_full (attrs->len,
+                                (GDestroyNotify) gsound_attributes_unref);
+  for (i = 0; i < attrs->len; i++)
     {
-      g_task_return_error (task, inner_error);
-      g_object_unref (task);
-      return;
-    }
-
-  hash_table_to_prop_list (attrs, proplist);
+      GSoundAttributes *item;
 
-  res = ca_context_play_full (self->ca,
-                              g_direct_hash (cancellable),
-                              proplist,
-                              on_ca_play_full_finished,
-                              task);
+      item = gsound_attributes_newv (g_ptr_array_index (attrs, i), &error);
+      if (!item)
+        {
+          if (progress_notify)
+            progress_notify (progress_data);
+          g_ptr_array_unref (array);
+          g_task_return_error (task, error);
+          g_object_unref (task);
+          return;
+        }
 
-  if (cancellable)
-    g_cancellable_connect (cancellable,
-                           G_CALLBACK (on_cancellable_cancelled),
-                           g_object_ref (self),
-                           g_object_unref);
-
-  g_clear_pointer (&proplist, ca_proplist_destroy);
-
-  if (!test_return (res, &inner_error))
-    {
-      g_task_return_error (task, inner_error);
-      g_object_unref (task);
+      g_ptr_array_add (array, item);
     }
+
+  gsound_context_cache_in_thread (self, task, array, progress_callback,
+                                  progress_data, progress_notify);
 }
 
 /**
- * gsound_context_play_full_finish:
+ * gsound_context_cache_finish:
  * @context: A #GSoundContext
  * @result: Result object passed to the callback of
- *   gsound_context_play_full()
+ *   gsound_context_cache_async() or gsound_context_cachev_async()
  * @error: Return location for error
  *
- * Finish an async operation started by gsound_context_play_full(). You
- * must call this function in the callback to free memory and receive any
- * errors which occurred.
+ * Finish an async operation started by gsound_context_cache_async() or
+ * gsound_context_cachev_async().
  *
- * Returns: %TRUE if playing finished successfully
+ * Returns: %TRUE if every sound was cached successfully. Otherwise %FALSE,
+ *          and @error is set to the first error which occurred
  */
 gboolean
-gsound_context_play_full_finish (GSoundContext *self,
-                                 GAsyncResult  *result,
-                                 GError       **error)
+gsound_context_cache_finish (GSoundContext *self,
+                             GAsyncResult  *result,
+                             GError       **error)
 {
   g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
 
@@ -658,68 +4860,171 @@ gsound_context_play_full_finish (GSoundContext *self,
 }
 
 /**
- * gsound_context_cache: (skip)
+ * gsound_context_set_cache_budget:
  * @context: A #GSoundContext
- * @error: Return location for error
- * @...: A %NULL-terminated list of attribute-value pairs
+ * @budget: The most bytes of cached samples to keep track of, or 0 for
+ *   no limit
  *
- * Requests that a sound be cached on the server. See [#caching][gsound-GSound-Context#caching].
+ * Sets the memory budget for samples cached with gsound_context_cache()
+ * and friends. Whenever the samples in the cache index add up to more than
+ * @budget bytes, the least recently used ones are evicted from the index.
  *
- * Returns: %TRUE on success
+ * Note that the index is kept by GSound itself: evicting a sample means
+ * GSound forgets about it, but there is no way to remove the sample from
+ * the sound server. The size of a sample is only known if it was cached
+ * with #GSOUND_ATTR_MEDIA_FILENAME; samples cached by event ID alone count
+ * as zero bytes.
  */
-gboolean
-gsound_context_cache (GSoundContext *self,
-                      GError       **error,
-                      ...)
+void
+gsound_context_set_cache_budget (GSoundContext *self,
+                                 guint64        budget)
 {
-  ca_proplist *pl;
-  va_list args;
-  int res;
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
 
-  g_return_val_if_fail (GSOUND_IS_CONTEXT (self), FALSE);
+  _gsound_cache_index_set_budget (self->cache_index, budget);
+}
 
-  if ((res = ca_proplist_create (&pl)) != CA_SUCCESS)
-    return test_return (res, error);
+/**
+ * gsound_context_get_cache_stats:
+ * @context: A #GSoundContext
+ * @stats: (out caller-allocates): Return location for the statistics
+ *
+ * Fills in @stats with the current state of the client-side cache index
+ * of @context. A sample is added to the index when it has been cached
+ * successfully, and a "hit" is counted each time a sound with the same
+ * #GSOUND_ATTR_EVENT_ID is played.
+ */
+void
+gsound_context_get_cache_stats (GSoundContext    *self,
+                                GSoundCacheStats *stats)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (stats != NULL);
 
-  va_start (args, error);
-  var_args_to_prop_list (args, pl);
-  va_end (args);
+  _gsound_cache_index_get_stats (self->cache_index, stats);
+}
+
+/* Adds up the memory used to keep track of one play */
+static guint64
+gsound_play_get_memory (GSoundPlay *play)
+{
+  guint64 bytes = sizeof (GSoundPlay);
+  GTypeQuery query;
 
-  res = ca_context_cache_full (self->ca, pl);
+  if (play->task)
+    {
+      g_type_query (G_OBJECT_TYPE (play->task), &query);
+      bytes += query.instance_size;
+    }
 
-  g_clear_pointer (&pl, ca_proplist_destroy);
+  if (play->limit_event)
+    bytes += strlen (play->limit_event) + 1;
+  if (play->media_filename)
+    bytes += strlen (play->media_filename) + 1;
 
-  return test_return (res, error);
+  return bytes;
 }
 
 /**
- * gsound_context_cachev: (rename-to gsound_context_cache)
+ * gsound_context_get_memory_stats:
  * @context: A #GSoundContext
- * @attrs: (element-type utf8 utf8): Hash table of attrerties
- * @error: Return location for error, or %NULL
- * 
- * Requests that a sound be cached on the server. See [#caching][gsound-GSound-Context#caching].
+ * @stats: (out caller-allocates): Return location for the statistics
  *
- * This function is intented to be used by language bindings.
+ * Fills in @stats with how much memory @context is using to keep track of
+ * sounds which have not finished yet, and for its cache index and theme
+ * cache. This only counts GSound's own book-keeping: the property lists
+ * held by libcanberra and the samples held by the sound server are not
+ * included, so the figures are best used to watch for growth over time.
+ *
+ * To avoid allocating a record for every sound, @context keeps a small
+ * number of records of finished sounds for reuse; these are reported
+ * separately.
  */
-gboolean
-gsound_context_cachev (GSoundContext *self,
-                       GHashTable    *attrs,
-                       GError       **error)
+void
+gsound_context_get_memory_stats (GSoundContext     *self,
+                                 GSoundMemoryStats *stats)
 {
-  ca_proplist *proplist;
-  int res = ca_proplist_create (&proplist);
+  GHashTableIter iter;
+  gpointer value;
 
-  if (!test_return (res, error))
-    return FALSE;
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (stats != NULL);
 
-  hash_table_to_prop_list (attrs, proplist);
+  memset (stats, 0, sizeof (GSoundMemoryStats));
 
-  res = ca_context_cache_full (self->ca, proplist);
+  g_rec_mutex_lock (&self->lock);
 
-  g_clear_pointer (&proplist, ca_proplist_destroy);
+  g_hash_table_iter_init (&iter, self->plays);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    stats->play_bytes += gsound_play_get_memory (value);
 
-  return test_return (res, error);
+  stats->n_plays = g_hash_table_size (self->plays);
+  stats->play_bytes += g_hash_table_size (self->cancellables) *
+                       sizeof (CancellableEntry);
+
+  stats->n_pooled = self->n_pooled;
+  stats->pooled_bytes = self->n_pooled * sizeof (GSoundPlay);
+
+  g_rec_mutex_unlock (&self->lock);
+
+  stats->cache_bytes = _gsound_cache_index_get_memory (self->cache_index) +
+                       _gsound_theme_cache_get_memory (self->theme_cache);
+}
+
+/**
+ * gsound_context_set_stats_enabled:
+ * @context: A #GSoundContext
+ * @enabled: Whether to keep statistics
+ *
+ * Sets whether @context keeps statistics about the sounds it plays, which
+ * can be read with gsound_context_get_stats(). This is off by default, so
+ * that nothing is timed unless you ask for it. Turning it off does not
+ * clear the statistics gathered so far.
+ */
+void
+gsound_context_set_stats_enabled (GSoundContext *self,
+                                  gboolean       enabled)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  g_atomic_int_set (&self->stats_enabled, !!enabled);
+}
+
+/**
+ * gsound_context_get_stats:
+ * @context: A #GSoundContext
+ * @stats: (out caller-allocates): Return location for the statistics
+ *
+ * Fills in @stats with the statistics gathered since they were turned on
+ * with gsound_context_set_stats_enabled(), or last reset with
+ * gsound_context_reset_stats().
+ */
+void
+gsound_context_get_stats (GSoundContext   *self,
+                          GSoundPlayStats *stats)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&self->stats_lock);
+  *stats = self->stats;
+  g_mutex_unlock (&self->stats_lock);
+}
+
+/**
+ * gsound_context_reset_stats:
+ * @context: A #GSoundContext
+ *
+ * Sets all of the statistics kept by @context back to zero.
+ */
+void
+gsound_context_reset_stats (GSoundContext *self)
+{
+  g_return_if_fail (GSOUND_IS_CONTEXT (self));
+
+  g_mutex_lock (&self->stats_lock);
+  memset (&self->stats, 0, sizeof self->stats);
+  g_mutex_unlock (&self->stats_lock);
 }
 
 static gboolean
@@ -755,17 +5060,131 @@ gsound_context_real_init (GInitable    *initable,
   g_clear_pointer (&pl, ca_proplist_destroy);
 
   if (!test_return (success, error))
+    {
       g_clear_pointer (&self->ca, ca_context_destroy);
+      return FALSE;
+    }
 
   return TRUE;
 }
 
+static void
+gsound_context_init_job (GSoundContext *self,
+                         GSoundJob     *job)
+{
+  GTask *task = ((GSoundTaskJob *) job)->task;
+  GError *error = NULL;
+
+  g_slice_free (GSoundTaskJob, (GSoundTaskJob *) job);
+
+  if (gsound_context_real_init (G_INITABLE (self),
+                                g_task_get_cancellable (task),
+                                &error))
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+
+  g_object_unref (task);
+}
+
+static void
+gsound_context_real_init_async (GAsyncInitable     *initable,
+                                int                 io_priority,
+                                GCancellable       *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer            user_data)
+{
+  GSoundContext *self = GSOUND_CONTEXT (initable);
+  GTask *task;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_priority (task, io_priority);
+
+  gsound_context_queue_task (self, task, gsound_context_init_job);
+}
+
+static gboolean
+gsound_context_real_init_finish (GAsyncInitable *initable,
+                                 GAsyncResult   *result,
+                                 GError        **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, initable), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+gsound_event_limit_free (gpointer data)
+{
+  g_slice_free (GSoundEventLimit, data);
+}
+
 static void
 gsound_context_finalize (GObject *obj)
 {
   GSoundContext *self = GSOUND_CONTEXT (obj);
+  GHashTableIter iter;
+  gpointer value;
+
+  /* Every queued play holds a reference, so the queue is empty by now */
+  if (self->worker_started)
+    {
+      g_source_destroy (self->queue_source);
+      g_clear_pointer (&self->queue_source, g_source_unref);
+
+      g_main_loop_quit (self->worker_loop);
+      if (g_thread_self () != self->worker_thread)
+        g_thread_join (self->worker_thread);
+      else
+        g_thread_unref (self->worker_thread);
 
+      g_clear_pointer (&self->worker_loop, g_main_loop_unref);
+      g_clear_pointer (&self->worker_context, g_main_context_unref);
+    }
+
+  /* Sounds still playing are completed, like libcanberra does */
+  g_clear_pointer (&self->null_driver, _gsound_null_driver_free);
   g_clear_pointer (&self->ca, ca_context_destroy);
+  g_clear_pointer (&self->recorder, _gsound_recorder_free);
+
+  g_strfreev (self->warm_up_events);
+  g_clear_pointer (&self->cache_index, _gsound_cache_index_free);
+  g_clear_pointer (&self->theme_cache, _gsound_theme_cache_free);
+  g_clear_pointer (&self->scopes, g_hash_table_unref);
+  g_clear_pointer (&self->overlays, g_hash_table_unref);
+  g_clear_pointer (&self->dispatch.main_context, g_main_context_unref);
+
+  /* We may be running in one of the pool's threads, so don't wait for it */
+  if (self->dispatch.pool)
+    g_thread_pool_free (self->dispatch.pool, FALSE, FALSE);
+
+  while (self->play_pool)
+    {
+      GSoundPlay *play = self->play_pool;
+
+      self->play_pool = play->job.next;
+      g_slice_free (GSoundPlay, play);
+    }
+
+  /*
+   * Entries still waiting to be disconnected. This doesn't wait for
+   * handlers, as one of them may be finalizing us; any others hold a
+   * reference, so can't be running.
+   */
+  g_hash_table_iter_init (&iter, self->cancellables);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      CancellableEntry *entry = value;
+
+      g_signal_handler_disconnect (entry->cancellable, entry->handler_id);
+    }
+
+  g_clear_pointer (&self->event_limits, g_hash_table_unref);
+  g_mutex_clear (&self->stats_lock);
+  g_clear_pointer (&self->plays, g_hash_table_unref);
+  g_clear_pointer (&self->cancellables, g_hash_table_unref);
+  g_clear_pointer (&self->main_context, g_main_context_unref);
+  g_rec_mutex_clear (&self->lock);
 
   G_OBJECT_CLASS (gsound_context_parent_class)->finalize (obj);
 }
@@ -781,6 +5200,32 @@ gsound_context_class_init (GSoundContextClass *klass)
 static void
 gsound_context_init (GSoundContext *self)
 {
+  g_rec_mutex_init (&self->lock);
+
+  self->next_id = 1;
+
+  self->plays = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  self->cancellables =
+    g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                           NULL, (GDestroyNotify) cancellable_entry_unref);
+
+  self->main_context = g_main_context_ref_thread_default ();
+
+  self->cache_index = _gsound_cache_index_new ();
+  self->theme_cache = _gsound_theme_cache_new (self->main_context);
+  self->scopes = g_hash_table_new_full (NULL, NULL, NULL,
+                                        (GDestroyNotify) g_ptr_array_unref);
+  self->overlays = g_hash_table_new_full (NULL, NULL, NULL,
+                                          gsound_overlay_free);
+
+  g_queue_init (&self->voices);
+
+  self->event_limits = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              gsound_event_limit_free);
+  self->event_limits_sweep_size = 64;
+
+  g_mutex_init (&self->stats_lock);
 }
 
 static void
@@ -789,3 +5234,9 @@ gsound_context_initable_init (GInitableIface *iface)
   iface->init = gsound_context_real_init;
 }
 
+static void
+gsound_context_async_initable_init (GAsyncInitableIface *iface)
+{
+  iface->init_async = gsound_context_real_init_async;
+  iface->init_finish = gsound_context_real_init_finish;
+}
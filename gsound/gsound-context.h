@@ -22,6 +22,8 @@
 #include <gio/gio.h>
 
 #include "gsound-attr.h"
+#include "gsound-attributes.h"
+#include "gsound-playback.h"
 
 G_BEGIN_DECLS
 #define GSOUND_TYPE_CONTEXT              (gsound_context_get_type ())
@@ -33,6 +35,195 @@ G_BEGIN_DECLS
 typedef struct _GSoundContext GSoundContext;
 typedef struct _GSoundContextClass GSoundContextClass;
 
+/**
+ * GSoundCacheProgressCallback:
+ * @context: The #GSoundContext
+ * @n_done: The number of sounds which have been dealt with so far
+ * @n_total: The total number of sounds being cached
+ * @user_data: User data passed to gsound_context_cache_async()
+ *
+ * Called by gsound_context_cache_async() as each sound is uploaded.
+ */
+typedef void (*GSoundCacheProgressCallback) (GSoundContext *context,
+                                             guint          n_done,
+                                             guint          n_total,
+                                             gpointer       user_data);
+
+/**
+ * GSoundCacheStats:
+ * @n_samples: The number of samples in the cache index
+ * @n_bytes: The total size of those samples, as far as it is known
+ * @budget: The memory budget set with gsound_context_set_cache_budget(),
+ *   or 0 if there is none
+ * @hits: How many sounds have been played from a sample in the index
+ * @misses: How many sounds with an event ID have been played which were
+ *   not in the index
+ * @evictions: How many samples have been evicted to stay within @budget
+ *
+ * Statistics about the client-side cache index of a #GSoundContext, as
+ * returned by gsound_context_get_cache_stats().
+ */
+typedef struct
+{
+  guint   n_samples;
+  guint64 n_bytes;
+  guint64 budget;
+  guint64 hits;
+  guint64 misses;
+  guint64 evictions;
+} GSoundCacheStats;
+
+/**
+ * GSoundMemoryStats:
+ * @n_plays: The number of sounds which have not finished yet
+ * @play_bytes: The memory used to keep track of those sounds
+ * @n_pooled: The number of records of finished sounds kept for reuse
+ * @pooled_bytes: The memory held by those records
+ * @cache_bytes: The memory used by the cache index and the theme cache
+ *
+ * How much memory a #GSoundContext is using for its own book-keeping, as
+ * returned by gsound_context_get_memory_stats().
+ */
+typedef struct
+{
+  guint   n_plays;
+  guint64 play_bytes;
+  guint   n_pooled;
+  guint64 pooled_bytes;
+  guint64 cache_bytes;
+} GSoundMemoryStats;
+
+/**
+ * GSoundCoalesceMode:
+ * @GSOUND_COALESCE_DROP: Fail sounds which break the limit
+ * @GSOUND_COALESCE_MERGE: Treat sounds which break the limit as part of
+ *   the sound which is already playing, and report success
+ *
+ * What gsound_context_set_event_limit() does with a sound which arrives
+ * too soon after, or while too many instances of, the same event.
+ */
+typedef enum
+{
+  GSOUND_COALESCE_DROP,
+  GSOUND_COALESCE_MERGE
+} GSoundCoalesceMode;
+
+/**
+ * GSoundDispatchMode:
+ * @GSOUND_DISPATCH_THREAD_DEFAULT: Invoke callbacks in the thread-default
+ *   main context of the thread which started the sound
+ * @GSOUND_DISPATCH_MAIN_CONTEXT: Invoke callbacks in a chosen
+ *   #GMainContext
+ * @GSOUND_DISPATCH_THREAD_POOL: Invoke callbacks in a pool of threads
+ *   belonging to the context
+ * @GSOUND_DISPATCH_DIRECT: Invoke callbacks immediately, in whichever
+ *   thread finds out that the sound has finished
+ *
+ * Where a #GSoundContext invokes the callbacks of the sounds it plays. See
+ * gsound_context_set_completion_dispatch().
+ */
+typedef enum
+{
+  GSOUND_DISPATCH_THREAD_DEFAULT,
+  GSOUND_DISPATCH_MAIN_CONTEXT,
+  GSOUND_DISPATCH_THREAD_POOL,
+  GSOUND_DISPATCH_DIRECT
+} GSoundDispatchMode;
+
+/**
+ * GSoundPriority:
+ * @GSOUND_PRIORITY_LOW: Sounds which may be stolen first
+ * @GSOUND_PRIORITY_NORMAL: The default
+ * @GSOUND_PRIORITY_HIGH: Sounds which should only be stolen by other high
+ *   priority sounds
+ *
+ * How important a sound is when gsound_context_set_max_voices() has to
+ * choose which sound to stop, and when sounds are waiting to be submitted;
+ * see gsound_context_set_deadline(). See #GSOUND_ATTR_GSOUND_PRIORITY.
+ */
+typedef enum
+{
+  GSOUND_PRIORITY_LOW,
+  GSOUND_PRIORITY_NORMAL,
+  GSOUND_PRIORITY_HIGH
+} GSoundPriority;
+
+/**
+ * GSoundSampleFormat:
+ * @GSOUND_SAMPLE_FORMAT_ENCODED: A complete sound file, in any format
+ *   the sound server understands
+ * @GSOUND_SAMPLE_FORMAT_U8: Raw unsigned 8 bit PCM
+ * @GSOUND_SAMPLE_FORMAT_S16LE: Raw signed 16 bit little-endian PCM
+ *
+ * The format of a sound passed to gsound_context_play_bytes().
+ */
+typedef enum
+{
+  GSOUND_SAMPLE_FORMAT_ENCODED,
+  GSOUND_SAMPLE_FORMAT_U8,
+  GSOUND_SAMPLE_FORMAT_S16LE
+} GSoundSampleFormat;
+
+/**
+ * GSoundSampleSpec:
+ * @format: The sample format
+ * @rate: The sample rate in Hz, for raw PCM
+ * @channels: The number of interleaved channels, for raw PCM
+ *
+ * Describes a sound held in memory.
+ */
+typedef struct
+{
+  GSoundSampleFormat format;
+  guint              rate;
+  guint              channels;
+} GSoundSampleSpec;
+
+/**
+ * GSOUND_STATS_N_BUCKETS:
+ *
+ * The number of buckets in each latency histogram of #GSoundPlayStats.
+ */
+#define GSOUND_STATS_N_BUCKETS 32
+
+/**
+ * GSOUND_STATS_N_ERRORS:
+ *
+ * The size of the @n_errors array of #GSoundPlayStats.
+ */
+#define GSOUND_STATS_N_ERRORS 19
+
+/**
+ * GSoundPlayStats:
+ * @n_submitted: The number of sounds handed to the sound server
+ * @n_completed: The number of sounds which finished playing successfully
+ * @n_cancelled: The number of sounds which were cancelled
+ * @n_errors: The number of sounds which failed, indexed by the negated
+ *   #GSoundError code (so `n_errors[-GSOUND_ERROR_NOTFOUND]` counts sounds
+ *   which could not be found)
+ * @submit_latency: Histogram of how long it took to hand each sound to the
+ *   sound server
+ * @completion_latency: Histogram of how long each sound took from being
+ *   handed to the sound server until it finished. Only sounds whose end
+ *   GSound waits for (those with a callback or a #GCancellable) are counted
+ *
+ * Statistics about the sounds played by a #GSoundContext, as returned by
+ * gsound_context_get_stats().
+ *
+ * Bucket `i` of each histogram counts intervals of at least 2^i and less
+ * than 2^(i+1) microseconds, except that bucket 0 also counts intervals
+ * under one microsecond and the last bucket counts everything longer.
+ */
+typedef struct
+{
+  guint64 n_submitted;
+  guint64 n_completed;
+  guint64 n_cancelled;
+  guint64 n_errors[GSOUND_STATS_N_ERRORS];
+  guint64 submit_latency[GSOUND_STATS_N_BUCKETS];
+  guint64 completion_latency[GSOUND_STATS_N_BUCKETS];
+} GSoundPlayStats;
+
 /**
  * GSoundContext:
  * ca: the wrapped context
@@ -40,6 +231,16 @@ typedef struct _GSoundContextClass GSoundContextClass;
  * Wrapper for ca_context.
  */
 
+/**
+ * GSOUND_DRIVER_NULL:
+ *
+ * The name of GSound's own driver for gsound_context_set_driver(), which
+ * plays nothing and needs no sound server. Sounds are accepted as quickly
+ * as they can be made, and finish after as long as they would have taken
+ * to play, which makes it useful for load testing.
+ */
+#define GSOUND_DRIVER_NULL "gsound-null"
+
 #define GSOUND_ERROR (gsound_error_quark())
 GQuark gsound_error_quark(void);
 
@@ -66,12 +267,26 @@ typedef enum
 } GSoundError;
 GType             gsound_context_get_type          (void);
 
+GSoundContext    *gsound_context_get_default       (GError       **error);
+
+GSoundContext    *gsound_context_get_shared        (const char    *key,
+                                                    GError       **error);
+
 GSoundContext    *gsound_context_new               (GCancellable  *cancellable,
                                                     GError       **error);
 
 gboolean          gsound_context_open              (GSoundContext  *context,
                                                     GError        **error);
 
+void              gsound_context_open_async        (GSoundContext       *context,
+                                                    GCancellable        *cancellable,
+                                                    GAsyncReadyCallback  callback,
+                                                    gpointer             user_data);
+
+gboolean          gsound_context_open_finish       (GSoundContext  *context,
+                                                    GAsyncResult   *result,
+                                                    GError        **error);
+
 gboolean          gsound_context_set_attributes    (GSoundContext  *context,
                                                     GError        **error,
                                                     ...) G_GNUC_NULL_TERMINATED;
@@ -80,15 +295,79 @@ gboolean          gsound_context_set_attributesv   (GSoundContext  *context,
                                                     GHashTable     *attrs,
                                                     GError        **error);
 
+gboolean          gsound_context_set_attribute_double (GSoundContext  *context,
+                                                       GSoundAttrId    id,
+                                                       gdouble         value,
+                                                       GError        **error);
+
+gboolean          gsound_context_set_attribute_int (GSoundContext  *context,
+                                                    GSoundAttrId    id,
+                                                    gint            value,
+                                                    GError        **error);
+
+void              gsound_context_unset_attribute   (GSoundContext  *context,
+                                                    GSoundAttrId    id);
+
 gboolean          gsound_context_set_driver        (GSoundContext  *context,
                                                     const char     *driver,
                                                     GError        **error);
 
+void              gsound_context_set_simulated_duration (GSoundContext *context,
+                                                         guint          msec);
+
+void              gsound_context_start_recording   (GSoundContext  *context);
+
+gboolean          gsound_context_stop_recording    (GSoundContext  *context,
+                                                    const char     *filename,
+                                                    GError        **error);
+
+gboolean          gsound_context_replay            (GSoundContext  *context,
+                                                    const char     *filename,
+                                                    gdouble         speed,
+                                                    GCancellable   *cancellable,
+                                                    GError        **error);
+
+void              gsound_context_set_lazy          (GSoundContext  *context,
+                                                    gboolean        lazy);
+
+void              gsound_context_set_warm_up_events (GSoundContext      *context,
+                                                     const char * const *event_ids);
+
+void              gsound_context_set_max_voices    (GSoundContext  *context,
+                                                    guint           max_voices);
+
+void              gsound_context_set_deadline      (GSoundContext  *context,
+                                                    GSoundPriority  priority,
+                                                    guint           msec);
+
+void              gsound_context_push_attributes   (GSoundContext    *context,
+                                                    GSoundAttributes *attrs);
+
+void              gsound_context_pop_attributes    (GSoundContext    *context);
+
+void              gsound_context_set_theme_cache_enabled (GSoundContext *context,
+                                                          gboolean       enabled);
+
+void              gsound_context_set_completion_dispatch (GSoundContext     *context,
+                                                          GSoundDispatchMode mode,
+                                                          GMainContext      *main_context);
+
+void              gsound_context_set_event_limit   (GSoundContext      *context,
+                                                    const char         *event_id,
+                                                    guint               min_interval,
+                                                    guint               max_instances,
+                                                    GSoundCoalesceMode  mode);
+
 gboolean          gsound_context_play_simple       (GSoundContext  *context,
                                                     GCancellable   *cancellable,
                                                     GError        **error,
                                                     ...) G_GNUC_NULL_TERMINATED;
 
+gboolean          gsound_context_play_simple_ids   (GSoundContext  *context,
+                                                    GCancellable   *cancellable,
+                                                    GError        **error,
+                                                    ...);
+
 gboolean          gsound_context_play_simplev      (GSoundContext  *context,
                                                     GHashTable     *attrs,
                                                     GCancellable   *cancellable,
@@ -110,6 +389,73 @@ gboolean          gsound_context_play_full_finish  (GSoundContext  *context,
                                                     GAsyncResult   *result,
                                                     GError        **error);
 
+gboolean          gsound_context_play_attrs        (GSoundContext     *context,
+                                                    GSoundAttributes  *attrs,
+                                                    GCancellable      *cancellable,
+                                                    GError           **error);
+
+void              gsound_context_play_attrs_full   (GSoundContext       *context,
+                                                    GSoundAttributes    *attrs,
+                                                    GCancellable        *cancellable,
+                                                    GAsyncReadyCallback  callback,
+                                                    gpointer             user_data);
+
+void              gsound_context_play_batch        (GSoundContext       *context,
+                                                    GSoundAttributes   **attrs,
+                                                    guint                n_attrs,
+                                                    GCancellable        *cancellable,
+                                                    GAsyncReadyCallback  callback,
+                                                    gpointer             user_data);
+
+gboolean          gsound_context_play_batch_finish (GSoundContext  *context,
+                                                    GAsyncResult   *result,
+                                                    GPtrArray     **errors,
+                                                    GError        **error);
+
+gboolean          gsound_context_play_bytes        (GSoundContext          *context,
+                                                    GBytes                 *bytes,
+                                                    const GSoundSampleSpec *spec,
+                                                    GSoundAttributes       *attrs,
+                                                    GCancellable           *cancellable,
+                                                    GError                **error);
+
+void              gsound_context_play_bytes_full   (GSoundContext          *context,
+                                                    GBytes                 *bytes,
+                                                    const GSoundSampleSpec *spec,
+                                                    GSoundAttributes       *attrs,
+                                                    GCancellable           *cancellable,
+                                                    GAsyncReadyCallback     callback,
+                                                    gpointer                user_data);
+
+void              gsound_context_play_stream       (GSoundContext          *context,
+                                                    GInputStream           *stream,
+                                                    GSoundAttributes       *attrs,
+                                                    GCancellable           *cancellable,
+                                                    GAsyncReadyCallback     callback,
+                                                    gpointer                user_data);
+
+GSoundPlayback   *gsound_context_play_attrs_with_handle (GSoundContext    *context,
+                                                         GSoundAttributes *attrs,
+                                                         GError          **error);
+
+guint             gsound_context_get_playing       (GSoundContext          *context,
+                                                    GSoundPlayback * const *playbacks,
+                                                    guint                   n_playbacks,
+                                                    gboolean               *playing);
+
+gboolean          gsound_context_is_playing        (GSoundContext          *context,
+                                                    GSoundPlayback         *playback);
+
+gboolean          gsound_context_cache_bytes       (GSoundContext          *context,
+                                                    const char             *event_id,
+                                                    GBytes                 *bytes,
+                                                    const GSoundSampleSpec *spec,
+                                                    GError                **error);
+
+gboolean          gsound_context_cache_bank        (GSoundContext          *context,
+                                                    const char             *filename,
+                                                    GError                **error);
+
 gboolean          gsound_context_cache             (GSoundContext  *context,
                                                      GError        **error,
                                                      ...) G_GNUC_NULL_TERMINATED;
@@ -118,6 +464,50 @@ gboolean          gsound_context_cachev            (GSoundContext  *context,
                                                     GHashTable     *attrs,
                                                     GError        **error);
 
+gboolean          gsound_context_cache_attrs       (GSoundContext     *context,
+                                                    GSoundAttributes  *attrs,
+                                                    GError           **error);
+
+void              gsound_context_cache_async       (GSoundContext               *context,
+                                                    GSoundAttributes           **attrs,
+                                                    guint                        n_attrs,
+                                                    GCancellable                *cancellable,
+                                                    GSoundCacheProgressCallback  progress_callback,
+                                                    gpointer                     progress_data,
+                                                    GDestroyNotify               progress_notify,
+                                                    GAsyncReadyCallback          callback,
+                                                    gpointer                     user_data);
+
+void              gsound_context_cachev_async      (GSoundContext               *context,
+                                                    GPtrArray                   *attrs,
+                                                    GCancellable                *cancellable,
+                                                    GSoundCacheProgressCallback  progress_callback,
+                                                    gpointer                     progress_data,
+                                                    GDestroyNotify               progress_notify,
+                                                    GAsyncReadyCallback          callback,
+                                                    gpointer                     user_data);
+
+gboolean          gsound_context_cache_finish      (GSoundContext  *context,
+                                                    GAsyncResult   *result,
+                                                    GError        **error);
+
+void              gsound_context_set_cache_budget  (GSoundContext  *context,
+                                                    guint64         budget);
+
+void              gsound_context_get_cache_stats   (GSoundContext    *context,
+                                                    GSoundCacheStats *stats);
+
+void              gsound_context_get_memory_stats  (GSoundContext     *context,
+                                                    GSoundMemoryStats *stats);
+
+void              gsound_context_set_stats_enabled (GSoundContext  *context,
+                                                    gboolean        enabled);
+
+void              gsound_context_get_stats         (GSoundContext   *context,
+                                                    GSoundPlayStats *stats);
+
+void              gsound_context_reset_stats       (GSoundContext  *context);
+
 G_END_DECLS
 #endif /* GSOUND_CONTEXT_H */
 
@@ -0,0 +1,54 @@
+/* gsound-null-driver-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_NULL_DRIVER_PRIVATE_H
+#define GSOUND_NULL_DRIVER_PRIVATE_H
+
+#include "gsound-context.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GSoundNullDriver GSoundNullDriver;
+
+/* Called from the driver's own thread, like a libcanberra callback */
+typedef void (*GSoundNullDriverFunc) (guint32  id,
+                                      int      error_code,
+                                      gpointer user_data);
+
+GSoundNullDriver *_gsound_null_driver_new          (void);
+
+void              _gsound_null_driver_free         (GSoundNullDriver     *driver);
+
+void              _gsound_null_driver_set_duration (GSoundNullDriver     *driver,
+                                                    guint                 msec);
+
+int               _gsound_null_driver_play         (GSoundNullDriver     *driver,
+                                                    guint32               id,
+                                                    const char           *filename,
+                                                    GSoundNullDriverFunc  func,
+                                                    gpointer              user_data);
+
+int               _gsound_null_driver_cancel       (GSoundNullDriver     *driver,
+                                                    guint32               id);
+
+int               _gsound_null_driver_playing      (GSoundNullDriver     *driver,
+                                                    guint32               id,
+                                                    int                  *playing);
+
+G_END_DECLS
+#endif /* GSOUND_NULL_DRIVER_PRIVATE_H */
@@ -0,0 +1,409 @@
+/* gsound-null-driver.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * An in-process stand-in for a libcanberra driver, selected with
+ * GSOUND_DRIVER_NULL. Sounds are accepted straight away and "finish" on a
+ * timer of their own driver thread, after as long as the sound would have
+ * taken to play. That is worked out from the header of WAV files, and is
+ * a fixed default for anything else.
+ */
+
+#include "gsound-null-driver-private.h"
+
+#include <canberra.h>
+#include <glib/gstdio.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DEFAULT_DURATION 500
+
+/* How much of a file we look through for the fmt and data chunks */
+#define MAX_HEADER_SIZE 4096
+
+typedef struct
+{
+  GSoundNullDriver    *driver;
+  guint32              id;
+  GSource             *source;
+  GSoundNullDriverFunc func;
+  gpointer             user_data;
+
+  /* Set by whichever of the timer and a cancellation gets there first */
+  gboolean             done;
+} NullPlay;
+
+typedef struct
+{
+  guint32              id;
+  int                  error_code;
+  GSoundNullDriverFunc func;
+  gpointer             user_data;
+} NullCompletion;
+
+struct _GSoundNullDriver
+{
+  GMutex        lock;
+  guint         duration;
+
+  /* ID => NullPlay, for sounds which are still playing */
+  GHashTable   *plays;
+
+  /* Filename => duration in milliseconds, plus one */
+  GHashTable   *durations;
+
+  GMainContext *context;
+  GMainLoop    *loop;
+  GThread      *thread;
+};
+
+static gpointer
+null_driver_thread (gpointer data)
+{
+  GMainLoop *loop = data;
+  GMainContext *context = g_main_loop_get_context (loop);
+
+  g_main_context_push_thread_default (context);
+  g_main_loop_run (loop);
+  g_main_context_pop_thread_default (context);
+
+  g_main_loop_unref (loop);
+
+  return NULL;
+}
+
+GSoundNullDriver *
+_gsound_null_driver_new (void)
+{
+  GSoundNullDriver *driver;
+
+  driver = g_slice_new0 (GSoundNullDriver);
+  g_mutex_init (&driver->lock);
+  driver->duration = DEFAULT_DURATION;
+  driver->plays = g_hash_table_new (NULL, NULL);
+  driver->durations = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, NULL);
+
+  driver->context = g_main_context_new ();
+  driver->loop = g_main_loop_new (driver->context, FALSE);
+  driver->thread = g_thread_new ("gsound-null-driver", null_driver_thread,
+                                 g_main_loop_ref (driver->loop));
+
+  return driver;
+}
+
+/*
+ * Sounds which are still playing are failed with CA_ERROR_DESTROYED, as
+ * libcanberra does when a context is destroyed.
+ */
+void
+_gsound_null_driver_free (GSoundNullDriver *driver)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GSList *pending = NULL;
+  GSList *l;
+
+  g_main_loop_quit (driver->loop);
+  if (g_thread_self () != driver->thread)
+    {
+      g_thread_join (driver->thread);
+
+      /* Deliver any cancellations which were still on their way */
+      while (g_main_context_iteration (driver->context, FALSE))
+        ;
+    }
+  else
+    g_thread_unref (driver->thread);
+
+  g_mutex_lock (&driver->lock);
+  g_hash_table_iter_init (&iter, driver->plays);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      NullPlay *play = value;
+      NullCompletion *completion = g_slice_new (NullCompletion);
+
+      play->done = TRUE;
+      completion->id = play->id;
+      completion->error_code = CA_ERROR_DESTROYED;
+      completion->func = play->func;
+      completion->user_data = play->user_data;
+      pending = g_slist_prepend (pending, completion);
+
+      g_source_destroy (play->source);
+    }
+  g_hash_table_remove_all (driver->plays);
+  g_mutex_unlock (&driver->lock);
+
+  for (l = pending; l; l = l->next)
+    {
+      NullCompletion *completion = l->data;
+
+      if (completion->func)
+        completion->func (completion->id, CA_ERROR_DESTROYED,
+                          completion->user_data);
+      g_slice_free (NullCompletion, completion);
+    }
+  g_slist_free (pending);
+
+  g_main_loop_unref (driver->loop);
+  g_main_context_unref (driver->context);
+  g_hash_table_unref (driver->plays);
+  g_hash_table_unref (driver->durations);
+  g_mutex_clear (&driver->lock);
+  g_slice_free (GSoundNullDriver, driver);
+}
+
+/* Sets how long sounds play for when their length can't be worked out */
+void
+_gsound_null_driver_set_duration (GSoundNullDriver *driver,
+                                  guint             msec)
+{
+  g_mutex_lock (&driver->lock);
+  driver->duration = msec;
+  g_mutex_unlock (&driver->lock);
+}
+
+/* Returns the length of the WAV file @filename in milliseconds, or 0 */
+static guint
+read_wav_duration (const char *filename)
+{
+  guint8 header[MAX_HEADER_SIZE];
+  guint32 byte_rate = 0;
+  struct stat st;
+  gsize offset;
+  gssize len;
+  int fd;
+
+  fd = g_open (filename, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0)
+    return 0;
+
+  /* Never read from pipes, which would take the data from the sound */
+  if (fstat (fd, &st) < 0 || !S_ISREG (st.st_mode))
+    {
+      close (fd);
+      return 0;
+    }
+
+  len = pread (fd, header, sizeof header, 0);
+  close (fd);
+
+  if (len < 12 || memcmp (header, "RIFF", 4) != 0 ||
+      memcmp (header + 8, "WAVE", 4) != 0)
+    return 0;
+
+  for (offset = 12; offset + 8 <= (gsize) len; )
+    {
+      guint32 size;
+
+      memcpy (&size, header + offset + 4, sizeof size);
+      size = GUINT32_FROM_LE (size);
+
+      if (memcmp (header + offset, "fmt ", 4) == 0 &&
+          offset + 20 <= (gsize) len)
+        {
+          memcpy (&byte_rate, header + offset + 16, sizeof byte_rate);
+          byte_rate = GUINT32_FROM_LE (byte_rate);
+        }
+      else if (memcmp (header + offset, "data", 4) == 0)
+        {
+          if (byte_rate == 0)
+            return 0;
+
+          return MAX ((guint64) size * 1000 / byte_rate, 1);
+        }
+
+      /* Chunks are padded to an even length */
+      offset += 8 + (guint64) size + (size & 1);
+    }
+
+  return 0;
+}
+
+/* Called with the lock held */
+static guint
+get_duration (GSoundNullDriver *driver,
+              const char       *filename)
+{
+  gpointer cached;
+  guint duration;
+
+  if (!filename)
+    return driver->duration;
+
+  /* Samples passed in memory reuse the same descriptor paths */
+  if (g_str_has_prefix (filename, "/proc/"))
+    {
+      duration = read_wav_duration (filename);
+      return duration ? duration : driver->duration;
+    }
+
+  if (g_hash_table_lookup_extended (driver->durations, filename,
+                                    NULL, &cached))
+    duration = GPOINTER_TO_UINT (cached);
+  else
+    {
+      duration = read_wav_duration (filename);
+      g_hash_table_insert (driver->durations, g_strdup (filename),
+                           GUINT_TO_POINTER (duration));
+    }
+
+  return duration ? duration : driver->duration;
+}
+
+static gboolean
+null_play_timeout (gpointer data)
+{
+  NullPlay *play = data;
+  GSoundNullDriver *driver = play->driver;
+  gboolean done;
+
+  g_mutex_lock (&driver->lock);
+  done = play->done;
+  play->done = TRUE;
+  if (!done)
+    g_hash_table_remove (driver->plays, GUINT_TO_POINTER (play->id));
+  g_mutex_unlock (&driver->lock);
+
+  if (!done && play->func)
+    play->func (play->id, CA_SUCCESS, play->user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* The play is owned by its timer, and freed when that is destroyed */
+static void
+null_play_free (gpointer data)
+{
+  NullPlay *play = data;
+
+  g_source_unref (play->source);
+  g_slice_free (NullPlay, play);
+}
+
+int
+_gsound_null_driver_play (GSoundNullDriver     *driver,
+                          guint32               id,
+                          const char           *filename,
+                          GSoundNullDriverFunc  func,
+                          gpointer              user_data)
+{
+  NullPlay *play;
+
+  g_mutex_lock (&driver->lock);
+
+  if (g_hash_table_contains (driver->plays, GUINT_TO_POINTER (id)))
+    {
+      g_mutex_unlock (&driver->lock);
+      return CA_ERROR_INVALID;
+    }
+
+  play = g_slice_new0 (NullPlay);
+  play->driver = driver;
+  play->id = id;
+  play->func = func;
+  play->user_data = user_data;
+  play->source = g_timeout_source_new (get_duration (driver, filename));
+  g_source_set_name (play->source, "[gsound] null driver sound");
+  g_source_set_callback (play->source, null_play_timeout, play,
+                         null_play_free);
+
+  g_hash_table_insert (driver->plays, GUINT_TO_POINTER (id), play);
+  g_source_attach (play->source, driver->context);
+
+  g_mutex_unlock (&driver->lock);
+
+  return CA_SUCCESS;
+}
+
+static gboolean
+null_completion_idle (gpointer data)
+{
+  NullCompletion *completion = data;
+
+  completion->func (completion->id, completion->error_code,
+                    completion->user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+null_completion_free (gpointer data)
+{
+  g_slice_free (NullCompletion, data);
+}
+
+/* As with libcanberra, the sound's callback is called from our thread */
+int
+_gsound_null_driver_cancel (GSoundNullDriver *driver,
+                            guint32           id)
+{
+  NullCompletion *completion = NULL;
+  NullPlay *play;
+
+  g_mutex_lock (&driver->lock);
+
+  play = g_hash_table_lookup (driver->plays, GUINT_TO_POINTER (id));
+  if (play && !play->done)
+    {
+      play->done = TRUE;
+      g_hash_table_remove (driver->plays, GUINT_TO_POINTER (id));
+
+      if (play->func)
+        {
+          completion = g_slice_new (NullCompletion);
+          completion->id = id;
+          completion->error_code = CA_ERROR_CANCELED;
+          completion->func = play->func;
+          completion->user_data = play->user_data;
+        }
+
+      g_source_destroy (play->source);
+    }
+
+  g_mutex_unlock (&driver->lock);
+
+  if (completion)
+    {
+      GSource *source = g_idle_source_new ();
+
+      g_source_set_name (source, "[gsound] null driver cancel");
+      g_source_set_callback (source, null_completion_idle, completion,
+                             null_completion_free);
+      g_source_attach (source, driver->context);
+      g_source_unref (source);
+    }
+
+  return CA_SUCCESS;
+}
+
+int
+_gsound_null_driver_playing (GSoundNullDriver *driver,
+                             guint32           id,
+                             int              *playing)
+{
+  g_mutex_lock (&driver->lock);
+  *playing = g_hash_table_contains (driver->plays, GUINT_TO_POINTER (id));
+  g_mutex_unlock (&driver->lock);
+
+  return CA_SUCCESS;
+}
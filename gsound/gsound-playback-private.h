@@ -0,0 +1,40 @@
+/* gsound-playback-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_PLAYBACK_PRIVATE_H
+#define GSOUND_PLAYBACK_PRIVATE_H
+
+#include "gsound-context.h"
+
+G_BEGIN_DECLS
+
+GSoundPlayback   *_gsound_playback_new             (GSoundContext  *context,
+                                                    GMainContext   *main_context);
+
+void              _gsound_playback_set_id          (GSoundPlayback *playback,
+                                                    guint32         id);
+
+guint32           _gsound_playback_get_id          (GSoundPlayback *playback);
+
+GSoundContext    *_gsound_playback_get_context     (GSoundPlayback *playback);
+
+void              _gsound_playback_finish          (GSoundPlayback *playback,
+                                                    int             error_code);
+
+G_END_DECLS
+#endif /* GSOUND_PLAYBACK_PRIVATE_H */
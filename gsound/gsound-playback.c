@@ -0,0 +1,607 @@
+/* gsound-playback.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * SECTION: gsound-playback
+ * @title: GSoundPlayback
+ * @short_description: A handle on a single playing sound
+ * @see_also: #GSoundContext
+ *
+ * A #GSoundPlayback is returned by gsound_context_play_attrs_with_handle()
+ * and refers to the one sound which it started. It can stop that sound, ask
+ * whether it is still playing, and tells you when it has finished through
+ * the #GSoundPlayback::finished signal.
+ *
+ * Handles are much cheaper than giving every sound its own #GCancellable,
+ * so they are the best way to keep control of large numbers of sounds.
+ * Dropping the last reference to a handle does not stop its sound.
+ *
+ * Handles can also be waited on, singly with gsound_playback_wait_async(),
+ * or in groups with gsound_playback_wait_all_async() and
+ * gsound_playback_wait_any_async(). For example, to play several sounds
+ * at once and continue when they have all finished, in Vala:
+ *
+ * |[<!-- language="Vala" -->
+ * GSound.Playback[] playbacks = {};
+ * foreach (var sound in sounds)
+ *     playbacks += ctx.play_attrs_with_handle (sound);
+ * yield GSound.Playback.wait_all_async (playbacks, null);
+ * ]|
+ *
+ * As with any #GAsyncResult, the callbacks are invoked in the
+ * thread-default main context of the thread which started the wait, so
+ * results can be delivered to any #GMainContext by pushing it with
+ * g_main_context_push_thread_default() first.
+ */
+
+#include "gsound-playback-private.h"
+#include "gsound-context-private.h"
+
+#include <canberra.h>
+
+enum
+{
+  STATE_PLAYING,
+  STATE_FINISHED
+};
+
+struct _GSoundPlayback
+{
+  GObject        parent;
+
+  GSoundContext *context;
+  GMainContext  *main_context;
+  guint32        id;
+
+  volatile gint  state;
+  GError        *error;
+
+  /* Waiters to call when the sound finishes, protected by the lock */
+  GMutex         lock;
+  GSList        *waiters;
+};
+
+typedef void (*GSoundPlaybackWaitFunc) (GSoundPlayback *playback,
+                                        gpointer        user_data);
+
+typedef struct
+{
+  GSoundPlaybackWaitFunc func;
+  gpointer               user_data;
+} GSoundPlaybackWaiter;
+
+/*
+ * A wait on one or more handles. Each handle being waited on holds a
+ * reference, so this outlives the task, which is taken by whoever
+ * completes it first.
+ */
+typedef struct
+{
+  volatile gint  ref_count;
+  gpointer       task;
+  GSource       *cancel_source;
+
+  gboolean       any;
+  volatile gint  remaining;
+  GMutex         lock;
+  GError        *first_error;
+} GSoundWait;
+
+struct _GSoundPlaybackClass
+{
+  GObjectClass parent_class;
+};
+
+enum
+{
+  SIGNAL_FINISHED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+G_DEFINE_TYPE (GSoundPlayback, gsound_playback, G_TYPE_OBJECT)
+
+static void
+gsound_playback_finalize (GObject *obj)
+{
+  GSoundPlayback *self = GSOUND_PLAYBACK (obj);
+
+  g_clear_object (&self->context);
+  g_clear_pointer (&self->main_context, g_main_context_unref);
+  g_clear_error (&self->error);
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (gsound_playback_parent_class)->finalize (obj);
+}
+
+static void
+gsound_playback_class_init (GSoundPlaybackClass *klass)
+{
+  GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+
+  obj_class->finalize = gsound_playback_finalize;
+
+  /**
+   * GSoundPlayback::finished:
+   * @playback: The #GSoundPlayback
+   * @error: (allow-none): Why the sound stopped early, or %NULL if it
+   *   played to the end
+   *
+   * Emitted once, in the thread-default main context of the thread which
+   * created the #GSoundContext, when the sound has finished or been
+   * stopped. A sound which was stopped finishes with
+   * %GSOUND_ERROR_CANCELED.
+   */
+  signals[SIGNAL_FINISHED] =
+    g_signal_new ("finished",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL, NULL,
+                  G_TYPE_NONE, 1, G_TYPE_ERROR);
+}
+
+static void
+gsound_playback_init (GSoundPlayback *self)
+{
+  self->state = STATE_PLAYING;
+  g_mutex_init (&self->lock);
+}
+
+GSoundPlayback *
+_gsound_playback_new (GSoundContext *context,
+                      GMainContext  *main_context)
+{
+  GSoundPlayback *self;
+
+  self = g_object_new (GSOUND_TYPE_PLAYBACK, NULL);
+  self->context = g_object_ref (context);
+  self->main_context = g_main_context_ref (main_context);
+
+  return self;
+}
+
+/* Called once, before the handle is given out */
+void
+_gsound_playback_set_id (GSoundPlayback *self,
+                         guint32         id)
+{
+  self->id = id;
+}
+
+guint32
+_gsound_playback_get_id (GSoundPlayback *self)
+{
+  return self->id;
+}
+
+GSoundContext *
+_gsound_playback_get_context (GSoundPlayback *self)
+{
+  return self->context;
+}
+
+static gboolean
+emit_finished (gpointer user_data)
+{
+  GSoundPlayback *self = user_data;
+
+  g_signal_emit (self, signals[SIGNAL_FINISHED], 0, self->error);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Marks the sound as finished, and emits ::finished from the main context.
+ * May be called from any thread.
+ */
+void
+_gsound_playback_finish (GSoundPlayback *self,
+                         int             error_code)
+{
+  GSList *waiters, *l;
+  GSource *source;
+
+  if (error_code != 0)
+    self->error = g_error_new_literal (GSOUND_ERROR, error_code,
+                                       ca_strerror (error_code));
+
+  /* The error is written before the state, and only read after it */
+  g_mutex_lock (&self->lock);
+  g_atomic_int_set (&self->state, STATE_FINISHED);
+  waiters = self->waiters;
+  self->waiters = NULL;
+  g_mutex_unlock (&self->lock);
+
+  for (l = waiters; l; l = l->next)
+    {
+      GSoundPlaybackWaiter *waiter = l->data;
+
+      waiter->func (self, waiter->user_data);
+      g_slice_free (GSoundPlaybackWaiter, waiter);
+    }
+  g_slist_free (waiters);
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, emit_finished,
+                         g_object_ref (self), g_object_unref);
+  g_source_attach (source, self->main_context);
+  g_source_unref (source);
+}
+
+/* Calls @func once the sound has finished, which may be straight away */
+static void
+gsound_playback_add_waiter (GSoundPlayback         *self,
+                            GSoundPlaybackWaitFunc  func,
+                            gpointer                user_data)
+{
+  GSoundPlaybackWaiter *waiter;
+
+  g_mutex_lock (&self->lock);
+
+  if (g_atomic_int_get (&self->state) == STATE_FINISHED)
+    {
+      g_mutex_unlock (&self->lock);
+      func (self, user_data);
+      return;
+    }
+
+  waiter = g_slice_new (GSoundPlaybackWaiter);
+  waiter->func = func;
+  waiter->user_data = user_data;
+  self->waiters = g_slist_prepend (self->waiters, waiter);
+
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+gsound_wait_unref (GSoundWait *wait)
+{
+  if (!g_atomic_int_dec_and_test (&wait->ref_count))
+    return;
+
+  if (wait->cancel_source)
+    g_source_unref (wait->cancel_source);
+
+  g_clear_error (&wait->first_error);
+  g_mutex_clear (&wait->lock);
+  g_slice_free (GSoundWait, wait);
+}
+
+/* Returns the task if nobody has completed it yet, or %NULL */
+static GTask *
+gsound_wait_take_task (GSoundWait *wait)
+{
+  GTask *task;
+
+  do
+    task = g_atomic_pointer_get (&wait->task);
+  while (task && !g_atomic_pointer_compare_and_exchange (&wait->task,
+                                                         task, NULL));
+
+  /* Nothing can be cancelled once the result is in */
+  if (task && wait->cancel_source)
+    g_source_destroy (wait->cancel_source);
+
+  return task;
+}
+
+static void
+on_wait_playback_finished (GSoundPlayback *playback,
+                           gpointer        user_data)
+{
+  GSoundWait *wait = user_data;
+  GTask *task = NULL;
+
+  if (wait->any)
+    {
+      task = gsound_wait_take_task (wait);
+      if (task)
+        g_task_return_pointer (task, g_object_ref (playback), g_object_unref);
+    }
+  else
+    {
+      if (playback->error)
+        {
+          g_mutex_lock (&wait->lock);
+          if (!wait->first_error)
+            wait->first_error = g_error_copy (playback->error);
+          g_mutex_unlock (&wait->lock);
+        }
+
+      if (g_atomic_int_dec_and_test (&wait->remaining))
+        task = gsound_wait_take_task (wait);
+
+      if (task && wait->first_error)
+        g_task_return_error (task, g_error_copy (wait->first_error));
+      else if (task)
+        g_task_return_boolean (task, TRUE);
+    }
+
+  if (task)
+    g_object_unref (task);
+
+  gsound_wait_unref (wait);
+}
+
+static gboolean
+on_wait_cancelled (gpointer user_data)
+{
+  GSoundWait *wait = g_task_get_task_data (user_data);
+  GTask *task;
+
+  task = gsound_wait_take_task (wait);
+  if (task)
+    {
+      g_task_return_error_if_cancelled (task);
+      g_object_unref (task);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gsound_wait_start (GSoundPlayback * const *playbacks,
+                   guint                   n_playbacks,
+                   gboolean                any,
+                   GCancellable           *cancellable,
+                   GAsyncReadyCallback     callback,
+                   gpointer                user_data,
+                   gpointer                source_tag)
+{
+  GSoundWait *wait;
+  GTask *task;
+  guint i;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, source_tag);
+
+  if (any && n_playbacks == 0)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                               "No sounds to wait for");
+      g_object_unref (task);
+      return;
+    }
+
+  if (n_playbacks == 0)
+    {
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
+    }
+
+  wait = g_slice_new0 (GSoundWait);
+  wait->ref_count = n_playbacks + 1;
+  wait->task = task;
+  wait->any = any;
+  wait->remaining = n_playbacks;
+  g_mutex_init (&wait->lock);
+
+  g_task_set_task_data (task, wait, (GDestroyNotify) gsound_wait_unref);
+
+  if (cancellable)
+    {
+      GSource *source = g_cancellable_source_new (cancellable);
+
+      /* The wait keeps its own reference so it can destroy the source */
+      wait->cancel_source = g_source_ref (source);
+      g_task_attach_source (task, source, on_wait_cancelled);
+      g_source_unref (source);
+    }
+
+  for (i = 0; i < n_playbacks; i++)
+    gsound_playback_add_waiter (playbacks[i], on_wait_playback_finished,
+                                wait);
+}
+
+/**
+ * gsound_playback_wait_async:
+ * @playback: A #GSoundPlayback
+ * @cancellable: (allow-none): A #GCancellable to stop waiting, or %NULL
+ * @callback: (scope async): callback
+ * @user_data: User data passed to @callback
+ *
+ * Waits for the sound to finish, which may already have happened. Call
+ * gsound_playback_wait_finish() from @callback to get the result.
+ * Cancelling @cancellable stops the wait, not the sound.
+ */
+void
+gsound_playback_wait_async (GSoundPlayback      *self,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+  g_return_if_fail (GSOUND_IS_PLAYBACK (self));
+
+  gsound_wait_start (&self, 1, FALSE, cancellable, callback, user_data,
+                     gsound_playback_wait_async);
+}
+
+/**
+ * gsound_playback_wait_finish:
+ * @playback: A #GSoundPlayback
+ * @result: Result object passed to the callback of
+ *   gsound_playback_wait_async()
+ * @error: Return location for error
+ *
+ * Finish an async operation started by gsound_playback_wait_async().
+ *
+ * Returns: %TRUE if the sound played to the end, or %FALSE, populating
+ *   @error with why it stopped early
+ */
+gboolean
+gsound_playback_wait_finish (GSoundPlayback *self,
+                             GAsyncResult   *result,
+                             GError        **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * gsound_playback_wait_all_async:
+ * @playbacks: (array length=n_playbacks): The handles to wait for
+ * @n_playbacks: The number of handles in @playbacks
+ * @cancellable: (allow-none): A #GCancellable to stop waiting, or %NULL
+ * @callback: (scope async): callback
+ * @user_data: User data passed to @callback
+ *
+ * Waits for every one of @playbacks to finish. Call
+ * gsound_playback_wait_all_finish() from @callback to get the result.
+ * Cancelling @cancellable stops the wait, not the sounds.
+ */
+void
+gsound_playback_wait_all_async (GSoundPlayback * const *playbacks,
+                                guint                   n_playbacks,
+                                GCancellable           *cancellable,
+                                GAsyncReadyCallback     callback,
+                                gpointer                user_data)
+{
+  g_return_if_fail (playbacks != NULL || n_playbacks == 0);
+
+  gsound_wait_start (playbacks, n_playbacks, FALSE, cancellable,
+                     callback, user_data, gsound_playback_wait_all_async);
+}
+
+/**
+ * gsound_playback_wait_all_finish:
+ * @result: Result object passed to the callback of
+ *   gsound_playback_wait_all_async()
+ * @error: Return location for error
+ *
+ * Finish an async operation started by gsound_playback_wait_all_async().
+ * The error of each sound is available from gsound_playback_get_error().
+ *
+ * Returns: %TRUE if every sound played to the end, or %FALSE, populating
+ *   @error with the first error
+ */
+gboolean
+gsound_playback_wait_all_finish (GAsyncResult  *result,
+                                 GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * gsound_playback_wait_any_async:
+ * @playbacks: (array length=n_playbacks): The handles to wait for
+ * @n_playbacks: The number of handles in @playbacks, at least 1
+ * @cancellable: (allow-none): A #GCancellable to stop waiting, or %NULL
+ * @callback: (scope async): callback
+ * @user_data: User data passed to @callback
+ *
+ * Waits for the first of @playbacks to finish. Call
+ * gsound_playback_wait_any_finish() from @callback to find out which.
+ * Cancelling @cancellable stops the wait, not the sounds.
+ */
+void
+gsound_playback_wait_any_async (GSoundPlayback * const *playbacks,
+                                guint                   n_playbacks,
+                                GCancellable           *cancellable,
+                                GAsyncReadyCallback     callback,
+                                gpointer                user_data)
+{
+  g_return_if_fail (playbacks != NULL || n_playbacks == 0);
+
+  gsound_wait_start (playbacks, n_playbacks, TRUE, cancellable,
+                     callback, user_data, gsound_playback_wait_any_async);
+}
+
+/**
+ * gsound_playback_wait_any_finish:
+ * @result: Result object passed to the callback of
+ *   gsound_playback_wait_any_async()
+ * @error: Return location for error
+ *
+ * Finish an async operation started by gsound_playback_wait_any_async().
+ *
+ * Returns: (transfer full): The handle which finished first, or %NULL if
+ *   the wait was cancelled
+ */
+GSoundPlayback *
+gsound_playback_wait_any_finish (GAsyncResult  *result,
+                                 GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * gsound_playback_stop:
+ * @playback: A #GSoundPlayback
+ *
+ * Stops the sound, if it is still playing. It then finishes with
+ * %GSOUND_ERROR_CANCELED.
+ */
+void
+gsound_playback_stop (GSoundPlayback *self)
+{
+  g_return_if_fail (GSOUND_IS_PLAYBACK (self));
+
+  if (g_atomic_int_get (&self->state) == STATE_FINISHED)
+    return;
+
+  _gsound_context_stop_play (self->context, self->id);
+}
+
+/**
+ * gsound_playback_is_playing:
+ * @playback: A #GSoundPlayback
+ *
+ * Asks whether the sound is still playing. A sound which is waiting to be
+ * handed to the sound server counts as playing.
+ *
+ * The answer comes from the sound server, so it may be %FALSE a little
+ * before #GSoundPlayback::finished is emitted.
+ *
+ * Returns: %TRUE if the sound is playing
+ */
+gboolean
+gsound_playback_is_playing (GSoundPlayback *self)
+{
+  g_return_val_if_fail (GSOUND_IS_PLAYBACK (self), FALSE);
+
+  if (g_atomic_int_get (&self->state) == STATE_FINISHED)
+    return FALSE;
+
+  return _gsound_context_is_play_active (self->context, self->id);
+}
+
+/**
+ * gsound_playback_get_error:
+ * @playback: A #GSoundPlayback
+ *
+ * Gets the reason the sound stopped early, once it has finished.
+ *
+ * Returns: (allow-none) (transfer none): The error, or %NULL if the sound
+ *   is still playing or played to the end
+ */
+const GError *
+gsound_playback_get_error (GSoundPlayback *self)
+{
+  g_return_val_if_fail (GSOUND_IS_PLAYBACK (self), NULL);
+
+  if (g_atomic_int_get (&self->state) != STATE_FINISHED)
+    return NULL;
+
+  return self->error;
+}
@@ -0,0 +1,70 @@
+/* gsound-playback.h
+ *
+ * Copyright (C) 2013 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_PLAYBACK_H
+#define GSOUND_PLAYBACK_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+#define GSOUND_TYPE_PLAYBACK             (gsound_playback_get_type ())
+#define GSOUND_PLAYBACK(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), GSOUND_TYPE_PLAYBACK, GSoundPlayback))
+#define GSOUND_PLAYBACK_CLASS(obj)       (G_TYPE_CHECK_CLASS_CAST ((obj), GSOUND_TYPE_PLAYBACK, GSoundPlaybackClass))
+#define GSOUND_IS_PLAYBACK(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GSOUND_TYPE_PLAYBACK))
+#define GSOUND_IS_PLAYBACK_CLASS(obj)    (G_TYPE_CHECK_CLASS_TYPE ((obj), GSOUND_TYPE_PLAYBACK))
+#define GSOUND_PLAYBACK_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), GSOUND_TYPE_PLAYBACK, GSoundPlaybackClass))
+typedef struct _GSoundPlayback GSoundPlayback;
+typedef struct _GSoundPlaybackClass GSoundPlaybackClass;
+
+GType             gsound_playback_get_type         (void);
+
+void              gsound_playback_stop             (GSoundPlayback *playback);
+
+gboolean          gsound_playback_is_playing       (GSoundPlayback *playback);
+
+const GError     *gsound_playback_get_error        (GSoundPlayback *playback);
+
+void              gsound_playback_wait_async       (GSoundPlayback      *playback,
+                                                    GCancellable        *cancellable,
+                                                    GAsyncReadyCallback  callback,
+                                                    gpointer             user_data);
+
+gboolean          gsound_playback_wait_finish      (GSoundPlayback      *playback,
+                                                    GAsyncResult        *result,
+                                                    GError             **error);
+
+void              gsound_playback_wait_all_async   (GSoundPlayback * const *playbacks,
+                                                    guint                   n_playbacks,
+                                                    GCancellable           *cancellable,
+                                                    GAsyncReadyCallback     callback,
+                                                    gpointer                user_data);
+
+gboolean          gsound_playback_wait_all_finish  (GAsyncResult        *result,
+                                                    GError             **error);
+
+void              gsound_playback_wait_any_async   (GSoundPlayback * const *playbacks,
+                                                    guint                   n_playbacks,
+                                                    GCancellable           *cancellable,
+                                                    GAsyncReadyCallback     callback,
+                                                    gpointer                user_data);
+
+GSoundPlayback   *gsound_playback_wait_any_finish  (GAsyncResult        *result,
+                                                    GError             **error);
+
+G_END_DECLS
+#endif /* GSOUND_PLAYBACK_H */
@@ -0,0 +1,53 @@
+/* gsound-recorder-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_RECORDER_PRIVATE_H
+#define GSOUND_RECORDER_PRIVATE_H
+
+#include "gsound-context.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GSoundRecorder GSoundRecorder;
+
+GSoundRecorder *_gsound_recorder_new       (void);
+
+void            _gsound_recorder_free      (GSoundRecorder     *recorder);
+
+void            _gsound_recorder_add_play  (GSoundRecorder     *recorder,
+                                            guint32             id,
+                                            GHashTable         *attrs,
+                                            const char * const *pairs);
+
+void            _gsound_recorder_add_event (GSoundRecorder     *recorder,
+                                            const char         *event,
+                                            guint32             id,
+                                            int                 code);
+
+gboolean        _gsound_recorder_save      (GSoundRecorder     *recorder,
+                                            const char         *filename,
+                                            GError            **error);
+
+gboolean        _gsound_recorder_replay    (GSoundContext      *context,
+                                            const char         *filename,
+                                            gdouble             speed,
+                                            GCancellable       *cancellable,
+                                            GError            **error);
+
+G_END_DECLS
+#endif /* GSOUND_RECORDER_PRIVATE_H */
@@ -0,0 +1,305 @@
+/* gsound-recorder.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Records what a context is asked to do, for gsound_context_start_recording(),
+ * and plays it back again for gsound_context_replay(). A trace is a text
+ * file with a header line followed by one line for each event:
+ *
+ *   # gsound trace 1
+ *   <usec>	play	<id>	<key>=<value>	...
+ *   <usec>	submit	<id>	<code>
+ *   <usec>	finish	<id>	<code>
+ *
+ * separated by tabs, where <usec> is the time since recording started and
+ * <code> is 0 or a #GSoundError. Keys and values are escaped with
+ * g_strescape(). Lines which aren't understood are skipped on replay, so
+ * the format can be extended.
+ */
+
+#include "gsound-recorder-private.h"
+
+#include <string.h>
+
+#define TRACE_HEADER "# gsound trace 1\n"
+
+struct _GSoundRecorder
+{
+  GMutex   lock;
+  gint64   start_time;
+  GString *trace;
+};
+
+GSoundRecorder *
+_gsound_recorder_new (void)
+{
+  GSoundRecorder *recorder;
+
+  recorder = g_slice_new0 (GSoundRecorder);
+  g_mutex_init (&recorder->lock);
+  recorder->start_time = g_get_monotonic_time ();
+  recorder->trace = g_string_new (TRACE_HEADER);
+
+  return recorder;
+}
+
+void
+_gsound_recorder_free (GSoundRecorder *recorder)
+{
+  g_string_free (recorder->trace, TRUE);
+  g_mutex_clear (&recorder->lock);
+  g_slice_free (GSoundRecorder, recorder);
+}
+
+/* Called with the lock held */
+static void
+append_escaped (GString    *trace,
+                const char *str)
+{
+  gchar *escaped = g_strescape (str, NULL);
+
+  g_string_append (trace, escaped);
+  g_free (escaped);
+}
+
+/* Called with the lock held */
+static void
+append_attr (GString    *trace,
+             const char *key,
+             const char *value)
+{
+  g_string_append_c (trace, '\t');
+  append_escaped (trace, key);
+  g_string_append_c (trace, '=');
+  append_escaped (trace, value);
+}
+
+/*
+ * Records a request to play sound @id, which has either the attributes
+ * in the hash table @attrs, or the %NULL-terminated list of key-value
+ * pairs @pairs.
+ */
+void
+_gsound_recorder_add_play (GSoundRecorder     *recorder,
+                           guint32             id,
+                           GHashTable         *attrs,
+                           const char * const *pairs)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  g_mutex_lock (&recorder->lock);
+
+  g_string_append_printf (recorder->trace, "%" G_GINT64_FORMAT "\tplay\t%u",
+                          now - recorder->start_time, id);
+
+  if (attrs)
+    {
+      GHashTableIter iter;
+      gpointer key, value;
+
+      g_hash_table_iter_init (&iter, attrs);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        append_attr (recorder->trace, key, value);
+    }
+  else
+    {
+      for (; pairs && pairs[0]; pairs += 2)
+        append_attr (recorder->trace, pairs[0], pairs[1]);
+    }
+
+  g_string_append_c (recorder->trace, '\n');
+
+  g_mutex_unlock (&recorder->lock);
+}
+
+/* Records that something, such as "submit" or "finish", happened to @id */
+void
+_gsound_recorder_add_event (GSoundRecorder *recorder,
+                            const char     *event,
+                            guint32         id,
+                            int             code)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  g_mutex_lock (&recorder->lock);
+  g_string_append_printf (recorder->trace,
+                          "%" G_GINT64_FORMAT "\t%s\t%u\t%d\n",
+                          now - recorder->start_time, event, id, code);
+  g_mutex_unlock (&recorder->lock);
+}
+
+gboolean
+_gsound_recorder_save (GSoundRecorder *recorder,
+                       const char     *filename,
+                       GError        **error)
+{
+  gboolean success;
+
+  g_mutex_lock (&recorder->lock);
+  success = g_file_set_contents (filename, recorder->trace->str,
+                                 recorder->trace->len, error);
+  g_mutex_unlock (&recorder->lock);
+
+  return success;
+}
+
+/*
+ * Parses a "play" line of a trace. Returns %FALSE for any other sort of
+ * line, otherwise sets @time and fills @attrs.
+ */
+static gboolean
+parse_play_line (const char *line,
+                 gint64     *time,
+                 GHashTable *attrs)
+{
+  gchar **fields;
+  gboolean is_play;
+  char *end;
+  guint i;
+
+  fields = g_strsplit (line, "\t", -1);
+  is_play = g_strv_length (fields) >= 3 && g_str_equal (fields[1], "play");
+
+  if (is_play)
+    {
+      *time = g_ascii_strtoll (fields[0], &end, 10);
+      is_play = *end == '\0';
+    }
+
+  for (i = 3; is_play && fields[i]; i++)
+    {
+      char *eq = strchr (fields[i], '=');
+
+      if (!eq)
+        continue;
+
+      *eq = '\0';
+      g_hash_table_insert (attrs, g_strcompress (fields[i]),
+                           g_strcompress (eq + 1));
+    }
+
+  g_strfreev (fields);
+
+  return is_play;
+}
+
+/*
+ * Plays the sounds in the trace @filename on @context, with the same
+ * spacing in time divided by @speed, or as quickly as possible if @speed
+ * is 0. Sounds which fail to play are skipped.
+ */
+gboolean
+_gsound_recorder_replay (GSoundContext *context,
+                         const char    *filename,
+                         gdouble        speed,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+  GDataInputStream *data;
+  GFileInputStream *input;
+  GHashTable *attrs;
+  gint64 start = 0;
+  gint64 first = -1;
+  gboolean success = TRUE;
+  GFile *file;
+  gchar *line;
+
+  file = g_file_new_for_path (filename);
+  input = g_file_read (file, cancellable, error);
+  g_object_unref (file);
+
+  if (!input)
+    return FALSE;
+
+  data = g_data_input_stream_new (G_INPUT_STREAM (input));
+  g_object_unref (input);
+
+  line = g_data_input_stream_read_line (data, NULL, cancellable, error);
+  if (!line || !g_str_equal (line, "# gsound trace 1"))
+    {
+      if (line || (error && !*error))
+        g_set_error (error, GSOUND_ERROR, GSOUND_ERROR_CORRUPT,
+                     "\"%s\" is not a GSound trace", filename);
+      g_free (line);
+      g_object_unref (data);
+      return FALSE;
+    }
+  g_free (line);
+
+  attrs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  while (TRUE)
+    {
+      GSoundAttributes *sound;
+      GError *inner_error = NULL;
+      gint64 time;
+
+      line = g_data_input_stream_read_line (data, NULL, cancellable,
+                                            &inner_error);
+      if (!line)
+        {
+          if (inner_error)
+            {
+              g_propagate_error (error, inner_error);
+              success = FALSE;
+            }
+          break;
+        }
+
+      g_hash_table_remove_all (attrs);
+      if (!parse_play_line (line, &time, attrs))
+        {
+          g_free (line);
+          continue;
+        }
+      g_free (line);
+
+      if (first < 0)
+        {
+          first = time;
+          start = g_get_monotonic_time ();
+        }
+
+      if (speed > 0)
+        {
+          gint64 due = start + (gint64) ((time - first) / speed);
+          gint64 now = g_get_monotonic_time ();
+
+          if (due > now)
+            g_usleep (due - now);
+        }
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        {
+          success = FALSE;
+          break;
+        }
+
+      sound = gsound_attributes_newv (attrs, NULL);
+      if (sound)
+        {
+          gsound_context_play_attrs (context, sound, NULL, NULL);
+          gsound_attributes_unref (sound);
+        }
+    }
+
+  g_hash_table_unref (attrs);
+  g_object_unref (data);
+
+  return success;
+}
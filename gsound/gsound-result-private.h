@@ -0,0 +1,84 @@
+/* gsound-result-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_RESULT_PRIVATE_H
+#define GSOUND_RESULT_PRIVATE_H
+
+#include "gsound-context.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A minimal GTask work-alike for the results of playing sounds. Unlike a
+ * GTask, it can deliver its callback somewhere other than the thread-default
+ * main context of the thread which created it.
+ */
+#define GSOUND_TYPE_RESULT (_gsound_result_get_type ())
+#define GSOUND_RESULT(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), GSOUND_TYPE_RESULT, GSoundResult))
+#define GSOUND_IS_RESULT(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GSOUND_TYPE_RESULT))
+
+typedef struct _GSoundResult GSoundResult;
+typedef struct _GSoundResultClass GSoundResultClass;
+
+/* Where a result's callback is invoked; see gsound_context_set_completion_dispatch() */
+typedef struct
+{
+  GSoundDispatchMode  mode;
+  GMainContext       *main_context;
+  GThreadPool        *pool;
+} GSoundDispatch;
+
+GType         _gsound_result_get_type          (void);
+
+GSoundResult *_gsound_result_new               (gpointer              source_object,
+                                                GCancellable         *cancellable,
+                                                GAsyncReadyCallback   callback,
+                                                gpointer              user_data,
+                                                const GSoundDispatch *dispatch);
+
+void          _gsound_result_set_source_tag    (GSoundResult  *result,
+                                                gpointer       source_tag);
+
+GCancellable *_gsound_result_get_cancellable   (GSoundResult  *result);
+
+void          _gsound_result_return_boolean    (GSoundResult  *result,
+                                                gboolean       value);
+
+void          _gsound_result_return_pointer    (GSoundResult  *result,
+                                                gpointer       value,
+                                                GDestroyNotify destroy);
+
+void          _gsound_result_return_error      (GSoundResult  *result,
+                                                GError        *error);
+
+gboolean      _gsound_result_return_error_if_cancelled (GSoundResult *result);
+
+gboolean      _gsound_result_is_valid          (gpointer       result,
+                                                gpointer       source_object);
+
+gboolean      _gsound_result_propagate_boolean (GSoundResult  *result,
+                                                GError       **error);
+
+gpointer      _gsound_result_propagate_pointer (GSoundResult  *result,
+                                                GError       **error);
+
+void          _gsound_result_pool_func         (gpointer       data,
+                                                gpointer       user_data);
+
+G_END_DECLS
+#endif /* GSOUND_RESULT_PRIVATE_H */
@@ -0,0 +1,310 @@
+/* gsound-result.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gsound-result-private.h"
+
+struct _GSoundResult
+{
+  GObject              parent;
+
+  GObject             *source_object;
+  GCancellable        *cancellable;
+  GAsyncReadyCallback  callback;
+  gpointer             user_data;
+  gpointer             source_tag;
+
+  GSoundDispatchMode   mode;
+  GMainContext        *main_context;
+  GThreadPool         *pool;
+
+  gboolean             returned;
+  gboolean             boolean_result;
+  gpointer             pointer_result;
+  GDestroyNotify       pointer_destroy;
+  GError              *error;
+};
+
+struct _GSoundResultClass
+{
+  GObjectClass parent_class;
+};
+
+static void gsound_result_async_result_init (GAsyncResultIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (GSoundResult, _gsound_result, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_RESULT,
+                                                gsound_result_async_result_init))
+
+static gpointer
+gsound_result_get_user_data (GAsyncResult *res)
+{
+  return GSOUND_RESULT (res)->user_data;
+}
+
+static GObject *
+gsound_result_get_source_object (GAsyncResult *res)
+{
+  GSoundResult *self = GSOUND_RESULT (res);
+
+  return self->source_object ? g_object_ref (self->source_object) : NULL;
+}
+
+static gboolean
+gsound_result_is_tagged (GAsyncResult *res,
+                         gpointer      source_tag)
+{
+  return GSOUND_RESULT (res)->source_tag == source_tag;
+}
+
+static void
+gsound_result_async_result_init (GAsyncResultIface *iface)
+{
+  iface->get_user_data = gsound_result_get_user_data;
+  iface->get_source_object = gsound_result_get_source_object;
+  iface->is_tagged = gsound_result_is_tagged;
+}
+
+static void
+gsound_result_finalize (GObject *obj)
+{
+  GSoundResult *self = GSOUND_RESULT (obj);
+
+  if (self->pointer_result && self->pointer_destroy)
+    self->pointer_destroy (self->pointer_result);
+
+  g_clear_object (&self->source_object);
+  g_clear_object (&self->cancellable);
+  g_clear_pointer (&self->main_context, g_main_context_unref);
+  g_clear_error (&self->error);
+
+  G_OBJECT_CLASS (_gsound_result_parent_class)->finalize (obj);
+}
+
+static void
+_gsound_result_class_init (GSoundResultClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = gsound_result_finalize;
+}
+
+static void
+_gsound_result_init (GSoundResult *self)
+{
+}
+
+GSoundResult *
+_gsound_result_new (gpointer              source_object,
+                    GCancellable         *cancellable,
+                    GAsyncReadyCallback   callback,
+                    gpointer              user_data,
+                    const GSoundDispatch *dispatch)
+{
+  GSoundResult *self;
+
+  self = g_object_new (GSOUND_TYPE_RESULT, NULL);
+
+  self->source_object = source_object ? g_object_ref (source_object) : NULL;
+  self->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+  self->callback = callback;
+  self->user_data = user_data;
+  self->mode = dispatch->mode;
+
+  switch (self->mode)
+    {
+    case GSOUND_DISPATCH_MAIN_CONTEXT:
+      self->main_context = g_main_context_ref (dispatch->main_context);
+      break;
+    case GSOUND_DISPATCH_THREAD_POOL:
+      self->pool = dispatch->pool;
+      break;
+    case GSOUND_DISPATCH_DIRECT:
+      break;
+    default:
+      self->main_context = g_main_context_ref_thread_default ();
+      break;
+    }
+
+  return self;
+}
+
+void
+_gsound_result_set_source_tag (GSoundResult *result,
+                               gpointer      source_tag)
+{
+  result->source_tag = source_tag;
+}
+
+GCancellable *
+_gsound_result_get_cancellable (GSoundResult *result)
+{
+  return result->cancellable;
+}
+
+static void
+gsound_result_invoke (GSoundResult *self)
+{
+  if (self->callback)
+    self->callback (self->source_object, G_ASYNC_RESULT (self),
+                    self->user_data);
+}
+
+static gboolean
+gsound_result_complete_in_idle (gpointer data)
+{
+  gsound_result_invoke (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+void
+_gsound_result_pool_func (gpointer data,
+                          gpointer user_data)
+{
+  gsound_result_invoke (data);
+  g_object_unref (data);
+}
+
+/*
+ * Hands the result to wherever its callback is to be invoked. The caller
+ * keeps its own reference, as with g_task_return_boolean() and friends.
+ */
+static void
+gsound_result_complete (GSoundResult *self)
+{
+  GSource *source;
+
+  g_return_if_fail (!self->returned);
+  self->returned = TRUE;
+
+  /* No callback means nobody is waiting, wherever they might have been */
+  if (!self->callback)
+    return;
+
+  switch (self->mode)
+    {
+    case GSOUND_DISPATCH_DIRECT:
+      gsound_result_invoke (self);
+      break;
+
+    case GSOUND_DISPATCH_THREAD_POOL:
+      g_thread_pool_push (self->pool, g_object_ref (self), NULL);
+      break;
+
+    default:
+      source = g_idle_source_new ();
+      g_source_set_name (source, "[gsound] complete_in_idle");
+      g_source_set_callback (source, gsound_result_complete_in_idle,
+                             g_object_ref (self), g_object_unref);
+      g_source_attach (source, self->main_context);
+      g_source_unref (source);
+      break;
+    }
+}
+
+void
+_gsound_result_return_boolean (GSoundResult *result,
+                               gboolean      value)
+{
+  result->boolean_result = value;
+  gsound_result_complete (result);
+}
+
+void
+_gsound_result_return_pointer (GSoundResult  *result,
+                               gpointer       value,
+                               GDestroyNotify destroy)
+{
+  result->pointer_result = value;
+  result->pointer_destroy = destroy;
+  gsound_result_complete (result);
+}
+
+/* Takes ownership of @error */
+void
+_gsound_result_return_error (GSoundResult *result,
+                             GError       *error)
+{
+  result->error = error;
+  gsound_result_complete (result);
+}
+
+gboolean
+_gsound_result_return_error_if_cancelled (GSoundResult *result)
+{
+  GError *error = NULL;
+
+  if (!g_cancellable_set_error_if_cancelled (result->cancellable, &error))
+    return FALSE;
+
+  _gsound_result_return_error (result, error);
+  return TRUE;
+}
+
+gboolean
+_gsound_result_is_valid (gpointer result,
+                         gpointer source_object)
+{
+  return GSOUND_IS_RESULT (result) &&
+         GSOUND_RESULT (result)->source_object == source_object;
+}
+
+/*
+ * Like a GTask, a result whose cancellable has been cancelled reports
+ * %G_IO_ERROR_CANCELLED, whatever it was completed with
+ */
+static gboolean
+gsound_result_propagate_error (GSoundResult *result,
+                               GError      **error)
+{
+  if (g_cancellable_set_error_if_cancelled (result->cancellable, error))
+    return TRUE;
+
+  if (result->error)
+    {
+      g_propagate_error (error, result->error);
+      result->error = NULL;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+gboolean
+_gsound_result_propagate_boolean (GSoundResult *result,
+                                  GError      **error)
+{
+  if (gsound_result_propagate_error (result, error))
+    return FALSE;
+
+  return result->boolean_result;
+}
+
+/* Returns ownership of the pointer, which may only be propagated once */
+gpointer
+_gsound_result_propagate_pointer (GSoundResult *result,
+                                  GError      **error)
+{
+  gpointer value;
+
+  if (gsound_result_propagate_error (result, error))
+    return NULL;
+
+  value = result->pointer_result;
+  result->pointer_result = NULL;
+
+  return value;
+}
@@ -0,0 +1,49 @@
+/* gsound-sample-file-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_SAMPLE_FILE_PRIVATE_H
+#define GSOUND_SAMPLE_FILE_PRIVATE_H
+
+#include "gsound-context.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GSoundSampleFile GSoundSampleFile;
+typedef struct _GSoundFeed GSoundFeed;
+
+GSoundSampleFile *_gsound_sample_file_new      (GBytes                 *bytes,
+                                                const GSoundSampleSpec *spec,
+                                                GError                **error);
+
+void              _gsound_sample_file_new_for_stream_async  (GInputStream        *stream,
+                                                             GCancellable        *cancellable,
+                                                             GAsyncReadyCallback  callback,
+                                                             gpointer             user_data);
+
+GSoundSampleFile *_gsound_sample_file_new_for_stream_finish (GInputStream        *stream,
+                                                             GAsyncResult        *result,
+                                                             GError             **error);
+
+GSoundSampleFile *_gsound_sample_file_ref      (GSoundSampleFile       *file);
+
+void              _gsound_sample_file_unref    (GSoundSampleFile       *file);
+
+const char       *_gsound_sample_file_get_path (GSoundSampleFile       *file);
+
+G_END_DECLS
+#endif /* GSOUND_SAMPLE_FILE_PRIVATE_H */
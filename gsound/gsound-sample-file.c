@@ -0,0 +1,461 @@
+/* gsound-sample-file.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * libcanberra can only play sounds from files, so sounds held in memory
+ * are handed to it as a file which never touches the disk: a memfd, opened
+ * through /proc/self/fd. Where memfd_create() isn't available we fall back
+ * to an unlinked-on-free temporary file.
+ *
+ * Raw PCM is given a WAV header, since that is a format every libcanberra
+ * backend can read.
+ *
+ * Streams are handed over as the read end of a pipe, which is fed from the
+ * stream as the backend reads from it, once the start of the stream has
+ * arrived. At most a pipe's worth of data plus
+ * one splice buffer is held in memory at a time, however long the sound.
+ */
+
+#include "config.h"
+
+#include "gsound-sample-file-private.h"
+
+#include <glib/gstdio.h>
+#include <glib-unix.h>
+#include <gio/gunixoutputstream.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
+
+struct _GSoundSampleFile
+{
+  volatile gint  ref_count;
+
+  gint           fd;
+  gchar         *path;
+  gboolean       is_temp;
+
+  /* Set if the file is a pipe being fed from a stream */
+  GSoundFeed    *feed;
+};
+
+/*
+ * The feed owns the read end of the pipe, and closes it once both the
+ * file and the splice have finished with it. Closing it any earlier could
+ * either let the fd number be reused before the backend opens it, or raise
+ * SIGPIPE in the middle of a write.
+ */
+struct _GSoundFeed
+{
+  volatile gint  ref_count;
+
+  gint           read_fd;
+  GCancellable  *cancellable;
+};
+
+/* The canonical 44 byte header of a PCM WAV file */
+typedef struct
+{
+  char    riff[4];
+  guint32 riff_size;
+  char    wave[4];
+  char    fmt[4];
+  guint32 fmt_size;
+  guint16 audio_format;
+  guint16 channels;
+  guint32 rate;
+  guint32 byte_rate;
+  guint16 block_align;
+  guint16 bits_per_sample;
+  char    data[4];
+  guint32 data_size;
+} WavHeader;
+
+G_STATIC_ASSERT (sizeof (WavHeader) == 44);
+
+static gboolean
+write_all (gint           fd,
+           gconstpointer  data,
+           gsize          size,
+           GError       **error)
+{
+  const guint8 *p = data;
+
+  while (size > 0)
+    {
+      gssize written = write (fd, p, size);
+
+      if (written < 0)
+        {
+          int saved_errno = errno;
+
+          if (saved_errno == EINTR)
+            continue;
+
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                       "Failed to write sound data: %s",
+                       g_strerror (saved_errno));
+          return FALSE;
+        }
+
+      p += written;
+      size -= written;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+write_wav_header (gint                    fd,
+                  const GSoundSampleSpec *spec,
+                  gsize                   data_size,
+                  GError                **error)
+{
+  guint bytes_per_sample;
+  WavHeader header;
+
+  switch (spec->format)
+    {
+    case GSOUND_SAMPLE_FORMAT_U8:
+      bytes_per_sample = 1;
+      break;
+    case GSOUND_SAMPLE_FORMAT_S16LE:
+      bytes_per_sample = 2;
+      break;
+    default:
+      bytes_per_sample = 0;
+      break;
+    }
+
+  if (bytes_per_sample == 0 || spec->rate == 0 || spec->channels == 0 || spec->channels > G_MAXUINT16 ||
+      data_size > G_MAXUINT32 - sizeof header)
+    {
+      g_set_error_literal (error, GSOUND_ERROR, GSOUND_ERROR_INVALID,
+                           "Invalid sample format");
+      return FALSE;
+    }
+
+  memcpy (header.riff, "RIFF", 4);
+  header.riff_size = GUINT32_TO_LE (sizeof header - 8 + data_size);
+  memcpy (header.wave, "WAVE", 4);
+  memcpy (header.fmt, "fmt ", 4);
+  header.fmt_size = GUINT32_TO_LE (16);
+  header.audio_format = GUINT16_TO_LE (1);
+  header.channels = GUINT16_TO_LE (spec->channels);
+  header.rate = GUINT32_TO_LE (spec->rate);
+  header.byte_rate = GUINT32_TO_LE (spec->rate * spec->channels *
+                                    bytes_per_sample);
+  header.block_align = GUINT16_TO_LE (spec->channels * bytes_per_sample);
+  header.bits_per_sample = GUINT16_TO_LE (bytes_per_sample * 8);
+  memcpy (header.data, "data", 4);
+  header.data_size = GUINT32_TO_LE (data_size);
+
+  return write_all (fd, &header, sizeof header, error);
+}
+
+static void
+gsound_feed_unref (GSoundFeed *feed)
+{
+  if (!g_atomic_int_dec_and_test (&feed->ref_count))
+    return;
+
+  close (feed->read_fd);
+  g_object_unref (feed->cancellable);
+  g_slice_free (GSoundFeed, feed);
+}
+
+static void
+on_feed_finished (GObject      *source,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+  GSoundFeed *feed = user_data;
+  GError *error = NULL;
+
+  /* The backend will simply see a short file, so there is no-one to tell */
+  if (g_output_stream_splice_finish (G_OUTPUT_STREAM (source),
+                                     result, &error) < 0)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_debug ("Failed to stream sound: %s", error->message);
+      g_error_free (error);
+    }
+
+  gsound_feed_unref (feed);
+}
+
+static void
+gsound_sample_file_free (GSoundSampleFile *file)
+{
+  if (file->feed)
+    {
+      g_cancellable_cancel (file->feed->cancellable);
+      gsound_feed_unref (file->feed);
+    }
+
+  if (file->fd >= 0)
+    close (file->fd);
+
+  if (file->is_temp)
+    g_unlink (file->path);
+
+  g_free (file->path);
+  g_slice_free (GSoundSampleFile, file);
+}
+
+/*
+ * Creates a file holding a copy of @bytes, which are in the format described
+ * by @spec, or are a complete sound file if @spec is %NULL.
+ */
+GSoundSampleFile *
+_gsound_sample_file_new (GBytes                 *bytes,
+                         const GSoundSampleSpec *spec,
+                         GError                **error)
+{
+  GSoundSampleFile *file;
+  gconstpointer data;
+  gsize size;
+
+  file = g_slice_new0 (GSoundSampleFile);
+  file->ref_count = 1;
+  file->fd = -1;
+
+#ifdef HAVE_MEMFD_CREATE
+  file->fd = memfd_create ("gsound-sample", MFD_CLOEXEC);
+  if (file->fd >= 0)
+    file->path = g_strdup_printf ("/proc/self/fd/%d", file->fd);
+#endif
+
+  if (file->fd < 0)
+    {
+      file->fd = g_file_open_tmp ("gsound-XXXXXX", &file->path, error);
+      if (file->fd < 0)
+        {
+          gsound_sample_file_free (file);
+          return NULL;
+        }
+      file->is_temp = TRUE;
+    }
+
+  data = g_bytes_get_data (bytes, &size);
+
+  if ((spec && spec->format != GSOUND_SAMPLE_FORMAT_ENCODED &&
+       !write_wav_header (file->fd, spec, size, error)) ||
+      !write_all (file->fd, data, size, error))
+    {
+      gsound_sample_file_free (file);
+      return NULL;
+    }
+
+  return file;
+}
+
+/*
+ * A stream file being set up: the start of the stream is read into the
+ * pipe before the file is returned, so that the backend doesn't block on
+ * it while reading the header, and the rest is spliced in afterwards.
+ */
+typedef struct
+{
+  GSoundSampleFile *file;
+  GOutputStream    *pipe;
+  gint              write_fd;
+
+  gsize             n_read;
+  guint8            buf[PIPE_BUF];
+} GSoundFeedStart;
+
+static void
+gsound_feed_start_free (gpointer data)
+{
+  GSoundFeedStart *start = data;
+
+  /* The splice was never started, so drop the reference it would hold */
+  if (start->pipe)
+    {
+      g_object_unref (start->pipe);
+      gsound_feed_unref (start->file->feed);
+    }
+
+  _gsound_sample_file_unref (start->file);
+  g_free (start);
+}
+
+static void on_feed_start_read (GObject      *source,
+                                GAsyncResult *result,
+                                gpointer      user_data);
+
+static void
+gsound_feed_start_read (GTask *task)
+{
+  GSoundFeedStart *start = g_task_get_task_data (task);
+
+  g_input_stream_read_async (g_task_get_source_object (task),
+                             start->buf + start->n_read,
+                             sizeof start->buf - start->n_read,
+                             G_PRIORITY_DEFAULT,
+                             g_task_get_cancellable (task),
+                             on_feed_start_read, task);
+}
+
+static void
+on_feed_start_read (GObject      *source,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  GTask *task = user_data;
+  GSoundFeedStart *start = g_task_get_task_data (task);
+  GSoundFeed *feed = start->file->feed;
+  GError *error = NULL;
+  gssize n;
+
+  n = g_input_stream_read_finish (G_INPUT_STREAM (source), result, &error);
+  if (n < 0)
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  start->n_read += n;
+  if (n > 0 && start->n_read < sizeof start->buf)
+    {
+      gsound_feed_start_read (task);
+      return;
+    }
+
+  /* The pipe is empty, so up to PIPE_BUF bytes go in without blocking */
+  if (!write_all (start->write_fd, start->buf, start->n_read, &error))
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  /* Otherwise the whole sound is already in the pipe */
+  if (n > 0)
+    {
+      g_output_stream_splice_async (start->pipe, G_INPUT_STREAM (source),
+                                    G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                    G_PRIORITY_DEFAULT, feed->cancellable,
+                                    on_feed_finished, feed);
+      g_clear_object (&start->pipe);
+    }
+
+  g_task_return_pointer (task, _gsound_sample_file_ref (start->file),
+                         (GDestroyNotify) _gsound_sample_file_unref);
+  g_object_unref (task);
+}
+
+/*
+ * Creates a file which reads from @stream as it is played. The stream is
+ * read asynchronously, so the thread-default main context must be running.
+ *
+ * The file is only returned once the first PIPE_BUF bytes of @stream have
+ * been read into it, which covers the header of any format libcanberra
+ * reads. A backend opens the file and reads its header while the context
+ * is locked, so it must not be held up by a slow stream. Cancelling
+ * @cancellable only stops this first read; the rest is stopped by freeing
+ * the file.
+ */
+void
+_gsound_sample_file_new_for_stream_async (GInputStream        *stream,
+                                          GCancellable        *cancellable,
+                                          GAsyncReadyCallback  callback,
+                                          gpointer             user_data)
+{
+  GSoundFeedStart *start;
+  GSoundFeed *feed;
+  GError *error = NULL;
+  GTask *task;
+  gint fds[2];
+
+  task = g_task_new (stream, cancellable, callback, user_data);
+  g_task_set_source_tag (task, _gsound_sample_file_new_for_stream_async);
+
+  if (!g_unix_open_pipe (fds, FD_CLOEXEC, &error))
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  /* Don't block the main context when the pipe is full */
+  if (!g_unix_set_fd_nonblocking (fds[1], TRUE, &error))
+    {
+      close (fds[0]);
+      close (fds[1]);
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  feed = g_slice_new0 (GSoundFeed);
+  feed->ref_count = 2;
+  feed->read_fd = fds[0];
+  feed->cancellable = g_cancellable_new ();
+
+  start = g_new0 (GSoundFeedStart, 1);
+  start->file = g_slice_new0 (GSoundSampleFile);
+  start->file->ref_count = 1;
+  start->file->fd = -1;
+  start->file->path = g_strdup_printf ("/proc/self/fd/%d", fds[0]);
+  start->file->feed = feed;
+  start->pipe = g_unix_output_stream_new (fds[1], TRUE);
+  start->write_fd = fds[1];
+
+  g_task_set_task_data (task, start, gsound_feed_start_free);
+  gsound_feed_start_read (task);
+}
+
+GSoundSampleFile *
+_gsound_sample_file_new_for_stream_finish (GInputStream  *stream,
+                                           GAsyncResult  *result,
+                                           GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, stream), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+GSoundSampleFile *
+_gsound_sample_file_ref (GSoundSampleFile *file)
+{
+  g_atomic_int_inc (&file->ref_count);
+
+  return file;
+}
+
+void
+_gsound_sample_file_unref (GSoundSampleFile *file)
+{
+  if (g_atomic_int_dec_and_test (&file->ref_count))
+    gsound_sample_file_free (file);
+}
+
+const char *
+_gsound_sample_file_get_path (GSoundSampleFile *file)
+{
+  return file->path;
+}
@@ -0,0 +1,46 @@
+/* gsound-theme-cache-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_THEME_CACHE_PRIVATE_H
+#define GSOUND_THEME_CACHE_PRIVATE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GSoundThemeCache GSoundThemeCache;
+
+GSoundThemeCache *_gsound_theme_cache_new          (GMainContext     *monitor_context);
+
+void              _gsound_theme_cache_free         (GSoundThemeCache *cache);
+
+void              _gsound_theme_cache_set_defaults (GSoundThemeCache *cache,
+                                                    const char       *theme,
+                                                    const char       *profile,
+                                                    const char       *locale);
+
+gchar            *_gsound_theme_cache_lookup       (GSoundThemeCache *cache,
+                                                    const char       *theme,
+                                                    const char       *profile,
+                                                    const char       *locale,
+                                                    const char       *event_id);
+
+guint64           _gsound_theme_cache_get_memory   (GSoundThemeCache *cache);
+
+G_END_DECLS
+#endif /* GSOUND_THEME_CACHE_PRIVATE_H */
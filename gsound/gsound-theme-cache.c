@@ -0,0 +1,632 @@
+/* gsound-theme-cache.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Remembers which file each event ID resolves to in the XDG sound theme, so
+ * that libcanberra can be given a filename rather than searching the theme
+ * directories for every sound it plays. The lookup follows libcanberra's:
+ * less specific event IDs are tried if there is no exact match ("bell" for
+ * "bell-window-system"), each in the theme, the themes it inherits and
+ * finally "freedesktop", and within each theme the requested output profile
+ * and locale are preferred.
+ *
+ * Every directory we look in is monitored, and the whole cache is dropped
+ * when any of them changes: the "sounds" directory of each data directory,
+ * so that new themes and user overrides are noticed, each theme and the
+ * sound directories it lists, and the locale directories within them.
+ */
+
+#include "gsound-theme-cache-private.h"
+
+#include <locale.h>
+#include <string.h>
+
+#define DEFAULT_THEME   "freedesktop"
+#define DEFAULT_PROFILE "stereo"
+
+/* One directory of sounds within a theme */
+typedef struct
+{
+  gchar *path;
+  gchar *profile;
+} ThemeDir;
+
+typedef struct
+{
+  GPtrArray  *dirs;
+  gchar     **inherits;
+} Theme;
+
+struct _GSoundThemeCache
+{
+  /* Held by the owner and by monitors waiting to be created */
+  volatile gint ref_count;
+  gboolean      closed;
+
+  GMutex        lock;
+  GMainContext *monitor_context;
+
+  /* See _gsound_theme_cache_set_defaults() */
+  gchar        *theme;
+  gchar        *profile;
+  gchar        *locale;
+
+  /* "theme\037profile\037locale\037event" => path, or "" if not found */
+  GHashTable   *paths;
+  GHashTable   *themes;
+
+  /* Monitored directory => GFileMonitor, or NULL if not created (yet) */
+  GHashTable   *monitors;
+  volatile gint stale;
+};
+
+static void
+theme_dir_free (gpointer data)
+{
+  ThemeDir *dir = data;
+
+  g_free (dir->path);
+  g_free (dir->profile);
+  g_slice_free (ThemeDir, dir);
+}
+
+static void
+theme_free (gpointer data)
+{
+  Theme *theme = data;
+
+  g_ptr_array_unref (theme->dirs);
+  g_strfreev (theme->inherits);
+  g_slice_free (Theme, theme);
+}
+
+static void
+on_theme_changed (GFileMonitor      *monitor,
+                  GFile             *file,
+                  GFile             *other_file,
+                  GFileMonitorEvent  event,
+                  gpointer           user_data)
+{
+  GSoundThemeCache *cache = user_data;
+
+  g_atomic_int_set (&cache->stale, TRUE);
+}
+
+/* A monitor to be created once the monitor context can be acquired */
+typedef struct
+{
+  GSoundThemeCache *cache;
+  gchar            *path;
+} MonitorRequest;
+
+static void gsound_theme_cache_unref (GSoundThemeCache *cache);
+
+/*
+ * Called with the lock held, by the owner of the monitor context. Monitors
+ * deliver their signals to the thread-default context, and that can only
+ * be pushed by a thread which has acquired it.
+ */
+static void
+create_monitor (GSoundThemeCache *cache,
+                const char       *path)
+{
+  GFileMonitor *monitor;
+  GFile *file;
+
+  g_main_context_push_thread_default (cache->monitor_context);
+
+  file = g_file_new_for_path (path);
+  monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, NULL);
+  g_object_unref (file);
+
+  g_main_context_pop_thread_default (cache->monitor_context);
+
+  if (monitor)
+    g_signal_connect (monitor, "changed", G_CALLBACK (on_theme_changed), cache);
+
+  /* A failed monitor is remembered too, so that we don't keep retrying */
+  g_hash_table_insert (cache->monitors, g_strdup (path), monitor);
+}
+
+static gboolean
+create_monitor_idle (gpointer data)
+{
+  MonitorRequest *req = data;
+  GSoundThemeCache *cache = req->cache;
+
+  g_mutex_lock (&cache->lock);
+  if (!cache->closed)
+    create_monitor (cache, req->path);
+  g_mutex_unlock (&cache->lock);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+monitor_request_free (gpointer data)
+{
+  MonitorRequest *req = data;
+
+  gsound_theme_cache_unref (req->cache);
+  g_free (req->path);
+  g_slice_free (MonitorRequest, req);
+}
+
+/* Called with the lock held */
+static void
+monitor_dir (GSoundThemeCache *cache,
+             const char       *path)
+{
+  MonitorRequest *req;
+  GSource *source;
+
+  if (g_hash_table_contains (cache->monitors, path))
+    return;
+
+  if (g_main_context_acquire (cache->monitor_context))
+    {
+      create_monitor (cache, path);
+      g_main_context_release (cache->monitor_context);
+      return;
+    }
+
+  /* Some other thread is running the context, so let it do the work */
+  g_hash_table_insert (cache->monitors, g_strdup (path), NULL);
+
+  req = g_slice_new (MonitorRequest);
+  req->cache = cache;
+  req->path = g_strdup (path);
+  g_atomic_int_inc (&cache->ref_count);
+
+  source = g_idle_source_new ();
+  g_source_set_name (source, "[gsound] theme cache monitor");
+  g_source_set_callback (source, create_monitor_idle, req,
+                         monitor_request_free);
+  g_source_attach (source, cache->monitor_context);
+  g_source_unref (source);
+}
+
+/* Called with the lock held. Adds the directories of @name in @base. */
+static void
+load_theme_from (GSoundThemeCache *cache,
+                 Theme            *theme,
+                 const char       *base,
+                 const char       *name)
+{
+  gchar *sounds_path, *theme_path, *index_path;
+  gchar **subdirs;
+  GKeyFile *index;
+  guint i;
+
+  /* Even if it doesn't exist yet, so that we notice it being created */
+  sounds_path = g_build_filename (base, "sounds", NULL);
+  monitor_dir (cache, sounds_path);
+  g_free (sounds_path);
+
+  theme_path = g_build_filename (base, "sounds", name, NULL);
+  if (!g_file_test (theme_path, G_FILE_TEST_IS_DIR))
+    {
+      g_free (theme_path);
+      return;
+    }
+
+  monitor_dir (cache, theme_path);
+
+  index = g_key_file_new ();
+  index_path = g_build_filename (theme_path, "index.theme", NULL);
+
+  if (g_key_file_load_from_file (index, index_path, G_KEY_FILE_NONE, NULL))
+    {
+      if (!theme->inherits)
+        theme->inherits = g_key_file_get_string_list (index, "Sound Theme",
+                                                      "Inherits", NULL, NULL);
+
+      subdirs = g_key_file_get_string_list (index, "Sound Theme",
+                                            "Directories", NULL, NULL);
+      for (i = 0; subdirs && subdirs[i]; i++)
+        {
+          ThemeDir *dir = g_slice_new (ThemeDir);
+
+          dir->path = g_build_filename (theme_path, subdirs[i], NULL);
+          dir->profile = g_key_file_get_string (index, subdirs[i],
+                                                "OutputProfile", NULL);
+          if (!dir->profile)
+            dir->profile = g_strdup (DEFAULT_PROFILE);
+
+          if (g_file_test (dir->path, G_FILE_TEST_IS_DIR))
+            monitor_dir (cache, dir->path);
+
+          g_ptr_array_add (theme->dirs, dir);
+        }
+      g_strfreev (subdirs);
+    }
+
+  g_key_file_free (index);
+  g_free (index_path);
+  g_free (theme_path);
+}
+
+/* Called with the lock held */
+static Theme *
+get_theme (GSoundThemeCache *cache,
+           const char       *name)
+{
+  const char * const *data_dirs;
+  Theme *theme;
+  guint i;
+
+  theme = g_hash_table_lookup (cache->themes, name);
+  if (theme)
+    return theme;
+
+  theme = g_slice_new0 (Theme);
+  theme->dirs = g_ptr_array_new_with_free_func (theme_dir_free);
+
+  load_theme_from (cache, theme, g_get_user_data_dir (), name);
+
+  data_dirs = g_get_system_data_dirs ();
+  for (i = 0; data_dirs[i]; i++)
+    load_theme_from (cache, theme, data_dirs[i], name);
+
+  g_hash_table_insert (cache->themes, g_strdup (name), theme);
+
+  return theme;
+}
+
+/*
+ * Called with the lock held. Looks for @name in @dir, preferring the most
+ * specific match for @locale ("de_DE.UTF-8@euro", then "de_DE", then "de",
+ * then "C") and finally the directory itself.
+ */
+static gchar *
+find_in_dir (GSoundThemeCache *cache,
+             const char       *dir,
+             const char       *locale,
+             const char       *name)
+{
+  static const char * const exts[] = { ".disabled", ".oga", ".ogg", ".wav" };
+  gchar *locales[5] = { NULL, };
+  guint n_locales = 0;
+  gchar *found = NULL;
+  guint i, j;
+
+  if (locale)
+    {
+      gchar *l = g_strdup (locale);
+      char *p;
+
+      locales[n_locales++] = g_strdup (l);
+      if ((p = strchr (l, '@')))
+        *p = '\0';
+      if ((p = strchr (l, '.')))
+        *p = '\0';
+      if (!g_str_equal (l, locales[0]))
+        locales[n_locales++] = g_strdup (l);
+      if ((p = strchr (l, '_')))
+        {
+          *p = '\0';
+          locales[n_locales++] = g_strdup (l);
+        }
+      g_free (l);
+    }
+  locales[n_locales++] = g_strdup ("C");
+
+  /* Directory monitors aren't recursive, so watch the locales as well */
+  for (i = 0; i < n_locales; i++)
+    {
+      gchar *path = g_build_filename (dir, locales[i], NULL);
+
+      if (g_file_test (path, G_FILE_TEST_IS_DIR))
+        monitor_dir (cache, path);
+      g_free (path);
+    }
+
+  for (i = 0; i <= n_locales && !found; i++)
+    {
+      for (j = 0; j < G_N_ELEMENTS (exts) && !found; j++)
+        {
+          gchar *basename = g_strconcat (name, exts[j], NULL);
+          gchar *path;
+
+          if (i < n_locales)
+            path = g_build_filename (dir, locales[i], basename, NULL);
+          else
+            path = g_build_filename (dir, basename, NULL);
+          g_free (basename);
+
+          if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+            found = path;
+          else
+            g_free (path);
+        }
+    }
+
+  for (i = 0; i < n_locales; i++)
+    g_free (locales[i]);
+
+  return found;
+}
+
+/* Called with the lock held. Searches @theme_name and what it inherits. */
+static gchar *
+find_in_theme (GSoundThemeCache *cache,
+               const char       *theme_name,
+               const char       *profile,
+               const char       *locale,
+               const char       *name,
+               GHashTable       *visited)
+{
+  Theme *theme;
+  gchar *found = NULL;
+  guint pass, i;
+
+  if (g_hash_table_contains (visited, theme_name))
+    return NULL;
+  g_hash_table_add (visited, (gpointer) theme_name);
+
+  theme = get_theme (cache, theme_name);
+
+  /* Directories for the requested profile first, then stereo ones */
+  for (pass = 0; pass < 2 && !found; pass++)
+    {
+      const char *want = pass == 0 ? profile : DEFAULT_PROFILE;
+
+      if (pass == 1 && g_str_equal (profile, DEFAULT_PROFILE))
+        break;
+
+      for (i = 0; i < theme->dirs->len && !found; i++)
+        {
+          ThemeDir *dir = theme->dirs->pdata[i];
+
+          if (g_str_equal (dir->profile, want))
+            found = find_in_dir (cache, dir->path, locale, name);
+        }
+    }
+
+  for (i = 0; !found && theme->inherits && theme->inherits[i]; i++)
+    found = find_in_theme (cache, theme->inherits[i], profile, locale,
+                           name, visited);
+
+  return found;
+}
+
+/* Called with the lock held */
+static gchar *
+resolve (GSoundThemeCache *cache,
+         const char       *theme,
+         const char       *profile,
+         const char       *locale,
+         const char       *event_id)
+{
+  gchar *name = g_strdup (event_id);
+  gchar *found = NULL;
+
+  while (!found)
+    {
+      GHashTable *visited = g_hash_table_new (g_str_hash, g_str_equal);
+      char *dash;
+
+      found = find_in_theme (cache, theme, profile, locale, name, visited);
+      if (!found)
+        found = find_in_theme (cache, DEFAULT_THEME, profile, locale,
+                               name, visited);
+      g_hash_table_unref (visited);
+
+      dash = strrchr (name, '-');
+      if (!dash)
+        break;
+      *dash = '\0';
+    }
+
+  g_free (name);
+
+  return found;
+}
+
+static void
+clear_monitor (gpointer data)
+{
+  GFileMonitor *monitor = data;
+
+  if (!monitor)
+    return;
+
+  g_signal_handlers_disconnect_matched (monitor, G_SIGNAL_MATCH_FUNC,
+                                        0, 0, NULL, on_theme_changed, NULL);
+  g_file_monitor_cancel (monitor);
+  g_object_unref (monitor);
+}
+
+GSoundThemeCache *
+_gsound_theme_cache_new (GMainContext *monitor_context)
+{
+  GSoundThemeCache *cache;
+
+  cache = g_slice_new0 (GSoundThemeCache);
+  cache->ref_count = 1;
+  g_mutex_init (&cache->lock);
+  cache->monitor_context = g_main_context_ref (monitor_context);
+  cache->paths = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, g_free);
+  cache->themes = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         g_free, theme_free);
+  cache->monitors = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, clear_monitor);
+
+  return cache;
+}
+
+static void
+gsound_theme_cache_unref (GSoundThemeCache *cache)
+{
+  if (!g_atomic_int_dec_and_test (&cache->ref_count))
+    return;
+
+  g_hash_table_unref (cache->monitors);
+  g_hash_table_unref (cache->themes);
+  g_hash_table_unref (cache->paths);
+  g_main_context_unref (cache->monitor_context);
+  g_free (cache->theme);
+  g_free (cache->profile);
+  g_free (cache->locale);
+  g_mutex_clear (&cache->lock);
+  g_slice_free (GSoundThemeCache, cache);
+}
+
+/* Monitors still waiting to be created keep the cache until they run */
+void
+_gsound_theme_cache_free (GSoundThemeCache *cache)
+{
+  g_mutex_lock (&cache->lock);
+  cache->closed = TRUE;
+  g_mutex_unlock (&cache->lock);
+
+  gsound_theme_cache_unref (cache);
+}
+
+/*
+ * Sets the theme, output profile and locale used when a sound doesn't give
+ * its own, as set on the context with gsound_context_set_attributes(). Any
+ * which are %NULL are left alone.
+ */
+void
+_gsound_theme_cache_set_defaults (GSoundThemeCache *cache,
+                                  const char       *theme,
+                                  const char       *profile,
+                                  const char       *locale)
+{
+  g_mutex_lock (&cache->lock);
+
+  if (theme)
+    {
+      g_free (cache->theme);
+      cache->theme = g_strdup (theme);
+    }
+  if (profile)
+    {
+      g_free (cache->profile);
+      cache->profile = g_strdup (profile);
+    }
+  if (locale)
+    {
+      g_free (cache->locale);
+      cache->locale = g_strdup (locale);
+    }
+
+  g_mutex_unlock (&cache->lock);
+}
+
+/*
+ * Returns the file which @event_id resolves to, or %NULL if there is none
+ * (or the sound is disabled), in which case libcanberra should be left to
+ * report the error itself. The other arguments override the defaults if
+ * they are not %NULL.
+ */
+gchar *
+_gsound_theme_cache_lookup (GSoundThemeCache *cache,
+                            const char       *theme,
+                            const char       *profile,
+                            const char       *locale,
+                            const char       *event_id)
+{
+  const char *path;
+  gchar *key, *result;
+
+  g_mutex_lock (&cache->lock);
+
+  if (g_atomic_int_get (&cache->stale))
+    {
+      g_atomic_int_set (&cache->stale, FALSE);
+      g_hash_table_remove_all (cache->paths);
+      g_hash_table_remove_all (cache->themes);
+    }
+
+  theme = theme ? theme : cache->theme ? cache->theme : DEFAULT_THEME;
+  profile = profile ? profile : cache->profile ? cache->profile : DEFAULT_PROFILE;
+  if (!locale)
+    locale = cache->locale ? cache->locale : setlocale (LC_MESSAGES, NULL);
+
+  key = g_strjoin ("\037", theme, profile, locale ? locale : "",
+                   event_id, NULL);
+
+  path = g_hash_table_lookup (cache->paths, key);
+  if (!path)
+    {
+      gchar *found = resolve (cache, theme, profile, locale, event_id);
+
+      if (found && g_str_has_suffix (found, ".disabled"))
+        g_clear_pointer (&found, g_free);
+
+      path = found ? found : g_strdup ("");
+      g_hash_table_insert (cache->paths, key, (gpointer) path);
+    }
+  else
+    {
+      g_free (key);
+    }
+
+  result = *path ? g_strdup (path) : NULL;
+
+  g_mutex_unlock (&cache->lock);
+
+  return result;
+}
+
+/* Roughly how much memory the cache uses, not counting the monitors */
+guint64
+_gsound_theme_cache_get_memory (GSoundThemeCache *cache)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  guint64 bytes = sizeof (GSoundThemeCache);
+  guint i;
+
+  g_mutex_lock (&cache->lock);
+
+  g_hash_table_iter_init (&iter, cache->paths);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    bytes += strlen (key) + strlen (value) + 2;
+
+  g_hash_table_iter_init (&iter, cache->themes);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      Theme *theme = value;
+
+      bytes += sizeof (Theme) + strlen (key) + 1;
+
+      for (i = 0; i < theme->dirs->len; i++)
+        {
+          ThemeDir *dir = g_ptr_array_index (theme->dirs, i);
+
+          bytes += sizeof (ThemeDir) + strlen (dir->path) + 1;
+          if (dir->profile)
+            bytes += strlen (dir->profile) + 1;
+        }
+
+      for (i = 0; theme->inherits && theme->inherits[i]; i++)
+        bytes += strlen (theme->inherits[i]) + 1;
+    }
+
+  g_hash_table_iter_init (&iter, cache->monitors);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    bytes += strlen (key) + 1;
+
+  g_mutex_unlock (&cache->lock);
+
+  return bytes;
+}
@@ -0,0 +1,43 @@
+/* gsound-trace-private.h
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSOUND_TRACE_PRIVATE_H
+#define GSOUND_TRACE_PRIVATE_H
+
+/*
+ * Static tracepoints, for use with SystemTap, bpftrace, perf or sysprof.
+ * The probes live in the "gsound" provider, so for example
+ *
+ *   bpftrace -e 'usdt:libgsound.so:gsound:play__complete { ... }'
+ *
+ * When <sys/sdt.h> is not available they compile to nothing.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define GSOUND_TRACE1(name, a)       DTRACE_PROBE1 (gsound, name, a)
+#define GSOUND_TRACE2(name, a, b)    DTRACE_PROBE2 (gsound, name, a, b)
+#define GSOUND_TRACE3(name, a, b, c) DTRACE_PROBE3 (gsound, name, a, b, c)
+#else
+#define GSOUND_TRACE1(name, a)       G_STMT_START { } G_STMT_END
+#define GSOUND_TRACE2(name, a, b)    G_STMT_START { } G_STMT_END
+#define GSOUND_TRACE3(name, a, b, c) G_STMT_START { } G_STMT_END
+#endif
+
+#endif /* GSOUND_TRACE_PRIVATE_H */
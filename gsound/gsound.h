@@ -19,6 +19,8 @@
 #ifndef GSOUND_H
 #define GSOUND_H
 
+#include "gsound-attributes.h"
 #include "gsound-context.h"
+#include "gsound-playback.h"
 
 #endif /* GSOUND_H */
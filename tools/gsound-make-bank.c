@@ -0,0 +1,429 @@
+/* gsound-make-bank.c
+ *
+ * Copyright (C) 2014 Tristan Brindle <t.c.brindle@gmail.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decodes sounds into a sample bank, which can then be loaded with
+ * gsound_context_cache_bank(). Each argument after the output file is
+ * either an event ID, which is looked up in the sound theme, or
+ * EVENT-ID=FILE to use a particular file. For example
+ *
+ *   gsound-make-bank --theme freedesktop sounds.bank \
+ *       bell message-new-instant my-app-ping=ping.wav
+ *
+ * WAV files holding 8 or 16 bit PCM are always supported. Ogg Vorbis files
+ * are supported if libvorbisfile was found when GSound was built.
+ */
+
+#include "config.h"
+
+#include "gsound-bank-private.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_VORBISFILE
+#include <vorbis/vorbisfile.h>
+#endif
+
+static char *theme = NULL;
+
+static GOptionEntry entries[] = {
+  { "theme", 't', 0, G_OPTION_ARG_STRING, &theme,
+    "Sound theme to look event IDs up in (default: freedesktop)", "NAME" },
+  { NULL }
+};
+
+typedef struct
+{
+  char             *event_id;
+  GSoundSampleSpec  spec;
+  GBytes           *data;
+} Sample;
+
+static void
+sample_free (Sample *sample)
+{
+  g_free (sample->event_id);
+  g_clear_pointer (&sample->data, g_bytes_unref);
+  g_free (sample);
+}
+
+static gboolean
+decode_wav (const char        *filename,
+            GSoundSampleSpec  *spec,
+            GBytes           **pcm,
+            GError           **error)
+{
+  const guint8 *p, *end;
+  gboolean have_fmt = FALSE;
+  gchar *contents;
+  gsize length;
+
+  if (!g_file_get_contents (filename, &contents, &length, error))
+    return FALSE;
+
+  p = (const guint8 *) contents;
+  end = p + length;
+
+  if (length < 12 || memcmp (p, "RIFF", 4) != 0 || memcmp (p + 8, "WAVE", 4) != 0)
+    goto invalid;
+
+  /* Walk the chunks, which are padded to an even length */
+  for (p += 12; end - p >= 8; )
+    {
+      guint32 size;
+
+      memcpy (&size, p + 4, 4);
+      size = GUINT32_FROM_LE (size);
+      if (size > (gsize) (end - p - 8))
+        goto invalid;
+
+      if (memcmp (p, "fmt ", 4) == 0 && size >= 16)
+        {
+          guint16 format, channels, bits;
+          guint32 rate;
+
+          memcpy (&format, p + 8, 2);
+          memcpy (&channels, p + 10, 2);
+          memcpy (&rate, p + 12, 4);
+          memcpy (&bits, p + 22, 2);
+
+          if (GUINT16_FROM_LE (format) != 1 ||
+              (GUINT16_FROM_LE (bits) != 8 && GUINT16_FROM_LE (bits) != 16))
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "%s: only 8 and 16 bit PCM WAV files are supported",
+                           filename);
+              g_free (contents);
+              return FALSE;
+            }
+
+          spec->format = GUINT16_FROM_LE (bits) == 8 ?
+            GSOUND_SAMPLE_FORMAT_U8 : GSOUND_SAMPLE_FORMAT_S16LE;
+          spec->channels = GUINT16_FROM_LE (channels);
+          spec->rate = GUINT32_FROM_LE (rate);
+          have_fmt = TRUE;
+        }
+      else if (memcmp (p, "data", 4) == 0 && have_fmt)
+        {
+          *pcm = g_bytes_new (p + 8, size);
+          g_free (contents);
+          return TRUE;
+        }
+
+      p += 8 + size + (size & 1);
+    }
+
+invalid:
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "%s: not a valid WAV file", filename);
+  g_free (contents);
+  return FALSE;
+}
+
+#ifdef HAVE_VORBISFILE
+static gboolean
+decode_vorbis (const char        *filename,
+               GSoundSampleSpec  *spec,
+               GBytes           **pcm,
+               GError           **error)
+{
+  OggVorbis_File vf;
+  vorbis_info *vi;
+  GByteArray *data;
+  char buf[4096];
+  int section;
+  long n;
+
+  if (ov_fopen (filename, &vf) != 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "%s: not a valid Ogg Vorbis file", filename);
+      return FALSE;
+    }
+
+  vi = ov_info (&vf, -1);
+  spec->format = GSOUND_SAMPLE_FORMAT_S16LE;
+  spec->channels = vi->channels;
+  spec->rate = vi->rate;
+
+  data = g_byte_array_new ();
+
+  /* Little-endian, 16 bit, signed */
+  while ((n = ov_read (&vf, buf, sizeof buf, 0, 2, 1, &section)) != 0)
+    {
+      if (n == OV_HOLE)
+        continue;
+
+      if (n < 0)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       "%s: failed to decode", filename);
+          g_byte_array_unref (data);
+          ov_clear (&vf);
+          return FALSE;
+        }
+
+      g_byte_array_append (data, (const guint8 *) buf, n);
+    }
+
+  ov_clear (&vf);
+  *pcm = g_byte_array_free_to_bytes (data);
+
+  return TRUE;
+}
+#endif
+
+static gboolean
+decode (const char        *filename,
+        GSoundSampleSpec  *spec,
+        GBytes           **pcm,
+        GError           **error)
+{
+  if (g_str_has_suffix (filename, ".wav"))
+    return decode_wav (filename, spec, pcm, error);
+
+#ifdef HAVE_VORBISFILE
+  if (g_str_has_suffix (filename, ".oga") || g_str_has_suffix (filename, ".ogg"))
+    return decode_vorbis (filename, spec, pcm, error);
+#endif
+
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+               "%s: unsupported file type", filename);
+  return FALSE;
+}
+
+static char *
+find_in_theme (const char *theme_name,
+               const char *name)
+{
+  static const char * const exts[] = { ".oga", ".ogg", ".wav" };
+  const char * const *dirs = g_get_system_data_dirs ();
+  int i, j;
+
+  for (i = -1; i == -1 || dirs[i]; i++)
+    {
+      const char *dir = i < 0 ? g_get_user_data_dir () : dirs[i];
+
+      for (j = 0; j < (int) G_N_ELEMENTS (exts); j++)
+        {
+          char *basename = g_strconcat (name, exts[j], NULL);
+          char *path = g_build_filename (dir, "sounds", theme_name,
+                                         "stereo", basename, NULL);
+
+          g_free (basename);
+          if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+            return path;
+          g_free (path);
+        }
+    }
+
+  return NULL;
+}
+
+/*
+ * Finds the file for @event_id the way libcanberra does: in the theme and
+ * then in the freedesktop theme, trying less specific names ("bell-window"
+ * then "bell" for "bell-window-system") if there is no exact match.
+ */
+static char *
+find_event_sound (const char *event_id)
+{
+  char *name = g_strdup (event_id);
+  char *path = NULL;
+
+  while (!path)
+    {
+      char *dash;
+
+      path = find_in_theme (theme, name);
+      if (!path && g_strcmp0 (theme, "freedesktop") != 0)
+        path = find_in_theme ("freedesktop", name);
+
+      dash = strrchr (name, '-');
+      if (!dash)
+        break;
+      *dash = '\0';
+    }
+
+  g_free (name);
+
+  return path;
+}
+
+static Sample *
+load_sample (const char  *arg,
+             GError     **error)
+{
+  const char *equals = strchr (arg, '=');
+  Sample *sample;
+  char *filename;
+
+  sample = g_new0 (Sample, 1);
+
+  if (equals)
+    {
+      sample->event_id = g_strndup (arg, equals - arg);
+      filename = g_strdup (equals + 1);
+    }
+  else
+    {
+      sample->event_id = g_strdup (arg);
+      filename = find_event_sound (arg);
+      if (!filename)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                       "No sound found for \"%s\" in theme \"%s\"",
+                       arg, theme);
+          sample_free (sample);
+          return NULL;
+        }
+    }
+
+  if (!decode (filename, &sample->spec, &sample->data, error))
+    g_clear_pointer (&sample, sample_free);
+
+  g_free (filename);
+
+  return sample;
+}
+
+static void
+pad_to_alignment (GByteArray *out)
+{
+  static const guint8 zeros[GSOUND_BANK_ALIGNMENT] = { 0, };
+  guint rem = out->len % GSOUND_BANK_ALIGNMENT;
+
+  if (rem)
+    g_byte_array_append (out, zeros, GSOUND_BANK_ALIGNMENT - rem);
+}
+
+static gboolean
+write_bank (const char  *filename,
+            GPtrArray   *samples,
+            GError     **error)
+{
+  GSoundBankHeader header;
+  GSoundBankEntry *entries;
+  GByteArray *out;
+  gboolean success;
+  guint i;
+
+  memcpy (header.magic, GSOUND_BANK_MAGIC, sizeof header.magic);
+  header.version = GUINT32_TO_LE (GSOUND_BANK_VERSION);
+  header.n_entries = GUINT32_TO_LE (samples->len);
+
+  out = g_byte_array_new ();
+  g_byte_array_append (out, (const guint8 *) &header, sizeof header);
+
+  /* The index is filled in once we know where everything is */
+  entries = g_new0 (GSoundBankEntry, samples->len);
+  g_byte_array_set_size (out, out->len + samples->len * sizeof *entries);
+
+  for (i = 0; i < samples->len; i++)
+    {
+      Sample *sample = samples->pdata[i];
+
+      entries[i].name_offset = GUINT32_TO_LE (out->len);
+      g_byte_array_append (out, (const guint8 *) sample->event_id,
+                           strlen (sample->event_id) + 1);
+    }
+
+  for (i = 0; i < samples->len; i++)
+    {
+      Sample *sample = samples->pdata[i];
+      gconstpointer data;
+      gsize size;
+
+      pad_to_alignment (out);
+      data = g_bytes_get_data (sample->data, &size);
+
+      entries[i].format = GUINT32_TO_LE (sample->spec.format);
+      entries[i].rate = GUINT32_TO_LE (sample->spec.rate);
+      entries[i].channels = GUINT32_TO_LE (sample->spec.channels);
+      entries[i].data_offset = GUINT64_TO_LE (out->len);
+      entries[i].data_size = GUINT64_TO_LE (size);
+
+      g_byte_array_append (out, data, size);
+    }
+
+  memcpy (out->data + sizeof header, entries, samples->len * sizeof *entries);
+  g_free (entries);
+
+  success = g_file_set_contents (filename, (const char *) out->data,
+                                 out->len, error);
+  g_byte_array_unref (out);
+
+  return success;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *opt_ctx;
+  GError *error = NULL;
+  GPtrArray *samples;
+  int i;
+
+  opt_ctx = g_option_context_new ("OUTPUT EVENT-ID[=FILE]...");
+  g_option_context_set_summary (opt_ctx,
+                                "Decodes sounds into a GSound sample bank.");
+  g_option_context_add_main_entries (opt_ctx, entries, NULL);
+
+  if (!g_option_context_parse (opt_ctx, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (opt_ctx);
+
+  if (argc < 3)
+    {
+      g_printerr ("Usage: %s OUTPUT EVENT-ID[=FILE]...\n", g_get_prgname ());
+      return EXIT_FAILURE;
+    }
+
+  if (!theme)
+    theme = g_strdup ("freedesktop");
+
+  samples = g_ptr_array_new_with_free_func ((GDestroyNotify) sample_free);
+
+  for (i = 2; i < argc; i++)
+    {
+      Sample *sample = load_sample (argv[i], &error);
+
+      if (!sample)
+        break;
+
+      g_ptr_array_add (samples, sample);
+    }
+
+  if (!error)
+    write_bank (argv[1], samples, &error);
+
+  g_ptr_array_unref (samples);
+
+  if (error)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
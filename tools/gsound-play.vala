@@ -23,6 +23,8 @@ string cache;
 int loops;
 double volume;
 string driver;
+int parallel;
+double rate;
 
 MainLoop main_loop;
 GSound.Context gs_ctx;
@@ -43,6 +45,10 @@ const OptionEntry[] opts = {
     "A floating point dB value for the sample volume (ex: 0.0)", "STRING" },
     { "backend", 'b', 0, OptionArg.STRING, ref driver,
     "libcanberra backend to use", "STRING" },
+    { "parallel", 'p', 0, OptionArg.INT, ref parallel,
+    "Stress test: keep up to this many sounds playing at once", "INTEGER" },
+    { "rate", 'r', 0, OptionArg.DOUBLE, ref rate,
+    "Stress test: start this many sounds per second (default: unlimited)", "RATE" },
     { null }
 };
 
@@ -53,6 +59,125 @@ async void play() throws Error
     }
 }
 
+/* Stress mode: --loop sounds in total, at most --parallel at a time,
+ * started at --rate per second */
+int in_flight;
+/* From starting each sound until it finished, so including its length */
+List<int64?> completion_times;
+HashTable<string, int> errors;
+int n_errors;
+SourceFunc stress_resume;
+
+void stress_wake()
+{
+    if (stress_resume != null) {
+        SourceFunc cb = (owned) stress_resume;
+        stress_resume = null;
+        Idle.add((owned) cb);
+    }
+}
+
+async void play_one()
+{
+    var start = get_monotonic_time();
+
+    try {
+        yield gs_ctx.play_fullv(attrs, null);
+        completion_times.prepend(get_monotonic_time() - start);
+    } catch (Error e) {
+        errors.replace(e.message, errors.lookup(e.message) + 1);
+        n_errors++;
+    }
+
+    in_flight--;
+    stress_wake();
+}
+
+async void stress() throws Error
+{
+    int64 interval = rate > 0 ? (int64) (1000000 / rate) : 0;
+    int total = loops;
+
+    completion_times = new List<int64?>();
+    errors = new HashTable<string, int>(str_hash, str_equal);
+
+    /* Upload the sample first, so that only playback is measured */
+    if (cache == "permanent" || cache == "volatile") {
+        gs_ctx.cachev(attrs);
+    }
+
+    var start = get_monotonic_time();
+
+    for (int i = 0; i < total; i++) {
+        if (interval > 0) {
+            var wait = start + i * interval - get_monotonic_time();
+            if (wait >= 1000) {
+                Timeout.add((uint) (wait / 1000), stress.callback);
+                yield;
+            }
+        }
+
+        while (in_flight >= parallel) {
+            stress_resume = stress.callback;
+            yield;
+        }
+
+        in_flight++;
+        play_one.begin();
+    }
+
+    while (in_flight > 0) {
+        stress_resume = stress.callback;
+        yield;
+    }
+
+    report(total, get_monotonic_time() - start);
+}
+
+double percentile(int64[] sorted, double p)
+{
+    if (sorted.length == 0) {
+        return 0.0;
+    }
+
+    var i = (int) Math.ceil(p / 100.0 * sorted.length) - 1;
+    return sorted[int.max(i, 0)] / 1000.0;
+}
+
+void report(int total, int64 elapsed)
+{
+    completion_times.sort((a, b) => {
+        int64 x = a;
+        int64 y = b;
+        return x < y ? -1 : (x > y ? 1 : 0);
+    });
+
+    var sorted = new int64[completion_times.length()];
+    var i = 0;
+    foreach (var l in completion_times) {
+        sorted[i++] = l;
+    }
+
+    var secs = elapsed / 1000000.0;
+
+    print("Sounds:     %d played, %d failed in %.3f s\n",
+          sorted.length, n_errors, secs);
+    if (secs > 0) {
+        print("Rate:       %.1f sounds/s\n", total / secs);
+    }
+    if (sorted.length > 0) {
+        print("Completion: min %.1f ms, p50 %.1f ms, p90 %.1f ms, " +
+              "p99 %.1f ms, max %.1f ms\n",
+              sorted[0] / 1000.0,
+              percentile(sorted, 50), percentile(sorted, 90),
+              percentile(sorted, 99), sorted[sorted.length - 1] / 1000.0);
+    }
+
+    errors.foreach((msg, count) => {
+        print("Error:      %s (%d)\n", msg, count);
+    });
+}
+
 int main(string[] args)
 {
     Environment.set_application_name("gsound-play");
@@ -94,15 +219,31 @@ int main(string[] args)
             loops = 1;
         }
         
-        play.begin((obj, res) => {
-            try {
-                play.end(res);
-            } catch (Error e) {
-                print("Error: %s\n", e.message);
-            } finally {
-                main_loop.quit();
+        if (parallel > 0 || rate > 0) {
+            if (parallel <= 0) {
+                parallel = int.MAX;
             }
-        });
+            
+            stress.begin((obj, res) => {
+                try {
+                    stress.end(res);
+                } catch (Error e) {
+                    print("Error: %s\n", e.message);
+                } finally {
+                    main_loop.quit();
+                }
+            });
+        } else {
+            play.begin((obj, res) => {
+                try {
+                    play.end(res);
+                } catch (Error e) {
+                    print("Error: %s\n", e.message);
+                } finally {
+                    main_loop.quit();
+                }
+            });
+        }
         
         main_loop = new MainLoop();
         main_loop.run();